@@ -40,6 +40,7 @@ FunctionPass *createAAPISelDag(AAPTargetMachine &TM,
                                CodeGenOpt::Level OptLevel);
 
 FunctionPass *createAAPShortInstrPeepholePass(AAPTargetMachine &TM);
+FunctionPass *createAAPShortRegHintsPass();
 
 namespace AAP {
 // Various helper methods to define operand ranges used throughout the backend
@@ -0,0 +1,880 @@
+//===-- AAPFastISel.cpp - AAP FastISel implementation ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the AAP-specific support for the FastISel class, which
+// is used in place of SelectionDAG at -O0. It covers the common i16
+// operations, loads and stores, calls, returns and branches. Anything else
+// falls back to SelectionDAG.
+//
+//===----------------------------------------------------------------------===//
+
+#include "AAP.h"
+#include "AAPISelLowering.h"
+#include "AAPInstrInfo.h"
+#include "AAPRegisterInfo.h"
+#include "AAPSubtarget.h"
+#include "AAPTargetMachine.h"
+#include "MCTargetDesc/AAPMCTargetDesc.h"
+#include "llvm/CodeGen/CallingConvLower.h"
+#include "llvm/CodeGen/FastISel.h"
+#include "llvm/CodeGen/FunctionLoweringInfo.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/IR/CallingConv.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+
+using namespace llvm;
+
+namespace {
+
+class AAPFastISel final : public FastISel {
+  // An address is either a register or a frame index, with a signed offset.
+  struct Address {
+    enum { RegBase, FrameIndexBase } BaseType = RegBase;
+    union {
+      unsigned Reg;
+      int FI;
+    } Base;
+    int64_t Offset = 0;
+
+    Address() { Base.Reg = 0; }
+  };
+
+  /// Subtarget - The subtarget of the function being selected, used by the
+  /// instruction predicates.
+  const AAPSubtarget *Subtarget;
+  LLVMContext *Context;
+
+public:
+  explicit AAPFastISel(FunctionLoweringInfo &FuncInfo,
+                       const TargetLibraryInfo *LibInfo)
+      : FastISel(FuncInfo, LibInfo),
+        Subtarget(&FuncInfo.MF->getSubtarget<AAPSubtarget>()),
+        Context(&FuncInfo.Fn->getContext()) {}
+
+  bool fastSelectInstruction(const Instruction *I) override;
+  unsigned fastMaterializeConstant(const Constant *C) override;
+  unsigned fastMaterializeAlloca(const AllocaInst *AI) override;
+  bool fastLowerArguments() override;
+  bool fastLowerCall(CallLoweringInfo &CLI) override;
+  unsigned fastEmit_ri(MVT VT, MVT RetVT, unsigned Opcode, unsigned Op0,
+                       bool Op0IsKill, uint64_t Imm) override;
+
+#include "AAPGenFastISel.inc"
+
+private:
+  const AAPTargetLowering &getTargetLowering() const {
+    return *Subtarget->getTargetLowering();
+  }
+
+  bool isTypeLegal(Type *Ty, MVT &VT);
+  bool isTypeSupported(Type *Ty, MVT &VT);
+
+  // Address selection
+  bool computeAddress(const Value *Obj, Address &Addr);
+  bool simplifyAddress(Address &Addr);
+  void addAddress(const MachineInstrBuilder &MIB, const Address &Addr);
+
+  // Instruction selection
+  bool selectLoad(const Instruction *I);
+  bool selectStore(const Instruction *I);
+  bool selectBranch(const Instruction *I);
+  bool selectCmp(const Instruction *I);
+  bool selectIntExt(const Instruction *I);
+  bool selectTrunc(const Instruction *I);
+  bool selectRet(const Instruction *I);
+
+  // Emission helpers
+  unsigned emitIntExt(MVT SrcVT, unsigned SrcReg, bool IsZExt);
+  bool getCmpOperands(const ICmpInst *CI, unsigned &LHSReg, unsigned &RHSReg);
+  unsigned emitBorrow(unsigned DiffReg);
+  unsigned materializeInt(int64_t Imm);
+};
+
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// Types and constants
+//===----------------------------------------------------------------------===//
+
+// Every immediate pattern carries a predicate, so TableGen does not emit a
+// combined fastEmit_ri. Dispatch on the immediate range here instead.
+unsigned AAPFastISel::fastEmit_ri(MVT VT, MVT RetVT, unsigned Opcode,
+                                  unsigned Op0, bool Op0IsKill, uint64_t Imm) {
+  if (Predicate_imm10(Imm))
+    if (unsigned Reg =
+            fastEmit_ri_Predicate_imm10(VT, RetVT, Opcode, Op0, Op0IsKill, Imm))
+      return Reg;
+  if (Predicate_imm9(Imm))
+    if (unsigned Reg =
+            fastEmit_ri_Predicate_imm9(VT, RetVT, Opcode, Op0, Op0IsKill, Imm))
+      return Reg;
+  if (Predicate_shift_imm6(Imm))
+    return fastEmit_ri_Predicate_shift_imm6(VT, RetVT, Opcode, Op0, Op0IsKill,
+                                            Imm);
+  return 0;
+}
+
+bool AAPFastISel::isTypeLegal(Type *Ty, MVT &VT) {
+  EVT Evt = TLI.getValueType(DL, Ty, /*AllowUnknown=*/true);
+  if (Evt == MVT::Other || !Evt.isSimple())
+    return false;
+  VT = Evt.getSimpleVT();
+  return TLI.isTypeLegal(VT);
+}
+
+// i1 and i8 values are held in i16 registers, with undefined upper bits
+bool AAPFastISel::isTypeSupported(Type *Ty, MVT &VT) {
+  if (isTypeLegal(Ty, VT))
+    return true;
+  return VT == MVT::i1 || VT == MVT::i8;
+}
+
+unsigned AAPFastISel::materializeInt(int64_t Imm) {
+  unsigned ResultReg = createResultReg(&AAP::GR64RegClass);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(AAP::MOVI_i16),
+          ResultReg)
+      .addImm(Imm & 0xffff);
+  return ResultReg;
+}
+
+unsigned AAPFastISel::fastMaterializeConstant(const Constant *C) {
+  if (const ConstantInt *CI = dyn_cast<ConstantInt>(C)) {
+    MVT VT;
+    if (!isTypeSupported(CI->getType(), VT))
+      return 0;
+    return materializeInt(CI->getZExtValue());
+  }
+
+  if (isa<ConstantPointerNull>(C))
+    return materializeInt(0);
+
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(C)) {
+    if (GV->isThreadLocal())
+      return 0;
+    unsigned ResultReg = createResultReg(&AAP::GR64RegClass);
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(AAP::MOVI_i16),
+            ResultReg)
+        .addGlobalAddress(GV);
+    return ResultReg;
+  }
+
+  return 0;
+}
+
+unsigned AAPFastISel::fastMaterializeAlloca(const AllocaInst *AI) {
+  DenseMap<const AllocaInst *, int>::iterator SI =
+      FuncInfo.StaticAllocaMap.find(AI);
+  if (SI == FuncInfo.StaticAllocaMap.end())
+    return 0;
+
+  // LEA is expanded during frame index elimination
+  unsigned ResultReg = createResultReg(&AAP::GR64RegClass);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(AAP::LEA),
+          ResultReg)
+      .addFrameIndex(SI->second)
+      .addImm(0);
+  return ResultReg;
+}
+
+//===----------------------------------------------------------------------===//
+// Address selection
+//===----------------------------------------------------------------------===//
+
+// Fold constant offsets from GEPs, and static allocas, into the address
+bool AAPFastISel::computeAddress(const Value *Obj, Address &Addr) {
+  const User *U = nullptr;
+  unsigned Opcode = Instruction::UserOp1;
+  if (const Instruction *I = dyn_cast<Instruction>(Obj)) {
+    // Don't walk into other basic blocks unless the object is an alloca from
+    // another block, otherwise it may not have a virtual register assigned.
+    if (FuncInfo.StaticAllocaMap.count(static_cast<const AllocaInst *>(Obj)) ||
+        FuncInfo.MBBMap[I->getParent()] == FuncInfo.MBB) {
+      Opcode = I->getOpcode();
+      U = I;
+    }
+  } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(Obj)) {
+    Opcode = CE->getOpcode();
+    U = CE;
+  }
+
+  switch (Opcode) {
+  default:
+    break;
+  case Instruction::BitCast:
+    return computeAddress(U->getOperand(0), Addr);
+  case Instruction::GetElementPtr: {
+    Address SavedAddr = Addr;
+    int64_t TmpOffset = Addr.Offset;
+    gep_type_iterator GTI = gep_type_begin(U);
+    for (User::const_op_iterator i = U->op_begin() + 1, e = U->op_end(); i != e;
+         ++i, ++GTI) {
+      const Value *Op = *i;
+      if (StructType *STy = GTI.getStructTypeOrNull()) {
+        const StructLayout *SL = DL.getStructLayout(STy);
+        unsigned Idx = cast<ConstantInt>(Op)->getZExtValue();
+        TmpOffset += SL->getElementOffset(Idx);
+        continue;
+      }
+      uint64_t S = DL.getTypeAllocSize(GTI.getIndexedType());
+      while (true) {
+        if (const ConstantInt *CI = dyn_cast<ConstantInt>(Op)) {
+          TmpOffset += CI->getSExtValue() * S;
+          break;
+        }
+        if (canFoldAddIntoGEP(U, Op)) {
+          // A compatible add with a constant operand. Fold the constant.
+          ConstantInt *CI =
+              cast<ConstantInt>(cast<AddOperator>(Op)->getOperand(1));
+          TmpOffset += CI->getSExtValue() * S;
+          Op = cast<AddOperator>(Op)->getOperand(0);
+          continue;
+        }
+        // A variable index is left to the generic GEP selection
+        Addr = SavedAddr;
+        goto unsupported_gep;
+      }
+    }
+    Addr.Offset = TmpOffset;
+    if (computeAddress(U->getOperand(0), Addr))
+      return true;
+    Addr = SavedAddr;
+  unsupported_gep:
+    break;
+  }
+  case Instruction::Alloca: {
+    const AllocaInst *AI = cast<AllocaInst>(Obj);
+    DenseMap<const AllocaInst *, int>::iterator SI =
+        FuncInfo.StaticAllocaMap.find(AI);
+    if (SI != FuncInfo.StaticAllocaMap.end()) {
+      Addr.BaseType = Address::FrameIndexBase;
+      Addr.Base.FI = SI->second;
+      return true;
+    }
+    break;
+  }
+  }
+
+  Addr.BaseType = Address::RegBase;
+  Addr.Base.Reg = getRegForValue(Obj);
+  return Addr.Base.Reg != 0;
+}
+
+// Loads and stores take a signed 10 bit offset. Larger offsets are added to
+// the base register.
+bool AAPFastISel::simplifyAddress(Address &Addr) {
+  if (AAP::isOff10(Addr.Offset))
+    return true;
+
+  if (Addr.BaseType == Address::FrameIndexBase) {
+    unsigned ResultReg = createResultReg(&AAP::GR64RegClass);
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(AAP::LEA),
+            ResultReg)
+        .addFrameIndex(Addr.Base.FI)
+        .addImm(0);
+    Addr.BaseType = Address::RegBase;
+    Addr.Base.Reg = ResultReg;
+  }
+
+  unsigned Reg = fastEmit_ri_(MVT::i16, ISD::ADD, Addr.Base.Reg,
+                              /*Op0IsKill=*/false, Addr.Offset & 0xffff,
+                              MVT::i16);
+  if (!Reg)
+    return false;
+  Addr.Base.Reg = Reg;
+  Addr.Offset = 0;
+  return true;
+}
+
+void AAPFastISel::addAddress(const MachineInstrBuilder &MIB,
+                             const Address &Addr) {
+  if (Addr.BaseType == Address::FrameIndexBase)
+    MIB.addFrameIndex(Addr.Base.FI);
+  else
+    MIB.addReg(Addr.Base.Reg);
+  MIB.addImm(Addr.Offset);
+}
+
+//===----------------------------------------------------------------------===//
+// Instruction selection
+//===----------------------------------------------------------------------===//
+
+bool AAPFastISel::fastSelectInstruction(const Instruction *I) {
+  switch (I->getOpcode()) {
+  default:
+    break;
+  case Instruction::Load:
+    return selectLoad(I);
+  case Instruction::Store:
+    return selectStore(I);
+  case Instruction::Br:
+    return selectBranch(I);
+  case Instruction::ICmp:
+    return selectCmp(I);
+  case Instruction::ZExt:
+  case Instruction::SExt:
+    return selectIntExt(I);
+  case Instruction::Trunc:
+    return selectTrunc(I);
+  case Instruction::Ret:
+    return selectRet(I);
+  }
+  return false;
+}
+
+bool AAPFastISel::selectLoad(const Instruction *I) {
+  const LoadInst *LI = cast<LoadInst>(I);
+  if (LI->isAtomic())
+    return false;
+
+  MVT VT;
+  if (!isTypeSupported(LI->getType(), VT))
+    return false;
+
+  // Misaligned word loads are split into byte loads by SelectionDAG
+  unsigned Align = LI->getAlignment();
+  if (VT == MVT::i16 && Align != 0 && Align < 2)
+    return false;
+
+  Address Addr;
+  if (!computeAddress(LI->getPointerOperand(), Addr) || !simplifyAddress(Addr))
+    return false;
+
+  unsigned ResultReg = createResultReg(&AAP::GR64RegClass);
+  MachineInstrBuilder MIB =
+      BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+              TII.get(VT == MVT::i16 ? AAP::LDW : AAP::LDB), ResultReg);
+  addAddress(MIB, Addr);
+  MIB.addMemOperand(createMachineMemOperandFor(LI));
+
+  updateValueMap(I, ResultReg);
+  return true;
+}
+
+bool AAPFastISel::selectStore(const Instruction *I) {
+  const StoreInst *SI = cast<StoreInst>(I);
+  if (SI->isAtomic())
+    return false;
+
+  const Value *Val = SI->getValueOperand();
+  MVT VT;
+  if (!isTypeSupported(Val->getType(), VT))
+    return false;
+
+  unsigned Align = SI->getAlignment();
+  if (VT == MVT::i16 && Align != 0 && Align < 2)
+    return false;
+
+  unsigned SrcReg = getRegForValue(Val);
+  if (!SrcReg)
+    return false;
+
+  // Booleans are stored as a zero extended byte
+  if (VT == MVT::i1) {
+    SrcReg = emitIntExt(VT, SrcReg, /*IsZExt=*/true);
+    if (!SrcReg)
+      return false;
+  }
+
+  Address Addr;
+  if (!computeAddress(SI->getPointerOperand(), Addr) || !simplifyAddress(Addr))
+    return false;
+
+  MachineInstrBuilder MIB =
+      BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+              TII.get(VT == MVT::i16 ? AAP::STW : AAP::STB));
+  addAddress(MIB, Addr);
+  MIB.addReg(SrcReg);
+  MIB.addMemOperand(createMachineMemOperandFor(SI));
+  return true;
+}
+
+// Get the operands of a comparison, extended to 16 bits if needed
+bool AAPFastISel::getCmpOperands(const ICmpInst *CI, unsigned &LHSReg,
+                                 unsigned &RHSReg) {
+  MVT VT;
+  if (!isTypeSupported(CI->getOperand(0)->getType(), VT))
+    return false;
+
+  LHSReg = getRegForValue(CI->getOperand(0));
+  RHSReg = getRegForValue(CI->getOperand(1));
+  if (!LHSReg || !RHSReg)
+    return false;
+
+  if (VT != MVT::i16) {
+    LHSReg = emitIntExt(VT, LHSReg, !CI->isSigned());
+    RHSReg = emitIntExt(VT, RHSReg, !CI->isSigned());
+  }
+  return LHSReg && RHSReg;
+}
+
+// Get the AAP condition code for an integer comparison, swapping the
+// operands of those comparisons which do not have a direct equivalent.
+static AAPCC::CondCode getAAPCondCode(CmpInst::Predicate Pred, bool &Swap) {
+  Swap = false;
+  switch (Pred) {
+  default:
+    return AAPCC::COND_INVALID;
+  case CmpInst::ICMP_EQ:
+    return AAPCC::COND_EQ;
+  case CmpInst::ICMP_NE:
+    return AAPCC::COND_NE;
+  case CmpInst::ICMP_SGT:
+    Swap = true;
+    LLVM_FALLTHROUGH;
+  case CmpInst::ICMP_SLT:
+    return AAPCC::COND_LTS;
+  case CmpInst::ICMP_SGE:
+    Swap = true;
+    LLVM_FALLTHROUGH;
+  case CmpInst::ICMP_SLE:
+    return AAPCC::COND_LES;
+  case CmpInst::ICMP_UGT:
+    Swap = true;
+    LLVM_FALLTHROUGH;
+  case CmpInst::ICMP_ULT:
+    return AAPCC::COND_LTU;
+  case CmpInst::ICMP_UGE:
+    Swap = true;
+    LLVM_FALLTHROUGH;
+  case CmpInst::ICMP_ULE:
+    return AAPCC::COND_LEU;
+  }
+}
+
+bool AAPFastISel::selectBranch(const Instruction *I) {
+  const BranchInst *BI = cast<BranchInst>(I);
+  if (BI->isUnconditional())
+    return false;
+
+  MachineBasicBlock *TBB = FuncInfo.MBBMap[BI->getSuccessor(0)];
+  MachineBasicBlock *FBB = FuncInfo.MBBMap[BI->getSuccessor(1)];
+  const auto &AII = static_cast<const AAPInstrInfo &>(TII);
+
+  // Fold a comparison in the same block into the branch
+  const ICmpInst *CI = dyn_cast<ICmpInst>(BI->getCondition());
+  if (CI && FuncInfo.MBBMap[CI->getParent()] == FuncInfo.MBB) {
+    bool Swap;
+    AAPCC::CondCode CC = getAAPCondCode(CI->getPredicate(), Swap);
+    unsigned LHSReg, RHSReg;
+    if (CC == AAPCC::COND_INVALID || !getCmpOperands(CI, LHSReg, RHSReg))
+      return false;
+    if (Swap)
+      std::swap(LHSReg, RHSReg);
+
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+            TII.get(AII.getBranchOpcodeFromCond(CC)))
+        .addMBB(TBB)
+        .addReg(LHSReg)
+        .addReg(RHSReg);
+    finishCondBranch(BI->getParent(), TBB, FBB);
+    return true;
+  }
+
+  // Otherwise branch on the low bit of the condition
+  unsigned CondReg = getRegForValue(BI->getCondition());
+  if (!CondReg)
+    return false;
+  CondReg = emitIntExt(MVT::i1, CondReg, /*IsZExt=*/true);
+  unsigned ZeroReg = materializeInt(0);
+  if (!CondReg || !ZeroReg)
+    return false;
+
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(AAP::BNE_))
+      .addMBB(TBB)
+      .addReg(CondReg, RegState::Kill)
+      .addReg(ZeroReg, RegState::Kill);
+  finishCondBranch(BI->getParent(), TBB, FBB);
+  return true;
+}
+
+// Turn the borrow from the subtract which defined DiffReg into 0 or all
+// ones, by subtracting the difference from itself with borrow. Its low bit
+// is the borrow, which is all an i1 needs, as any use which depends on the
+// upper bits extends it first.
+unsigned AAPFastISel::emitBorrow(unsigned DiffReg) {
+  return fastEmitInst_rr(AAP::SUBC_r, &AAP::GR64RegClass, DiffReg, false,
+                         DiffReg, true);
+}
+
+// There are no set on condition instructions, so comparisons which are not
+// folded into a branch are computed from the borrow flag.
+bool AAPFastISel::selectCmp(const Instruction *I) {
+  const ICmpInst *CI = cast<ICmpInst>(I);
+  unsigned LHSReg, RHSReg;
+  if (!getCmpOperands(CI, LHSReg, RHSReg))
+    return false;
+
+  CmpInst::Predicate Pred = CI->getPredicate();
+  const TargetRegisterClass *RC = &AAP::GR64RegClass;
+
+  // Signed comparisons are unsigned comparisons with the sign bits flipped
+  if (CI->isSigned()) {
+    unsigned SignReg = materializeInt(0x8000);
+    LHSReg = fastEmitInst_rr(AAP::XOR_r, RC, LHSReg, false, SignReg, false);
+    RHSReg = fastEmitInst_rr(AAP::XOR_r, RC, RHSReg, false, SignReg, true);
+    Pred = CI->getUnsignedPredicate();
+  }
+
+  // Reduce everything to an unsigned less than, possibly inverted
+  bool Invert = false;
+  switch (Pred) {
+  default:
+    return false;
+  case CmpInst::ICMP_NE:
+    Invert = true;
+    LLVM_FALLTHROUGH;
+  case CmpInst::ICMP_EQ: {
+    // The difference is zero if it is less than one
+    unsigned XorReg =
+        fastEmitInst_rr(AAP::XOR_r, RC, LHSReg, false, RHSReg, false);
+    LHSReg = fastEmitInst_ri(AAP::SUBI_i10, RC, XorReg, true, 1);
+    RHSReg = 0;
+    break;
+  }
+  case CmpInst::ICMP_UGE:
+    Invert = true;
+    LLVM_FALLTHROUGH;
+  case CmpInst::ICMP_ULT:
+    break;
+  case CmpInst::ICMP_ULE:
+    Invert = true;
+    LLVM_FALLTHROUGH;
+  case CmpInst::ICMP_UGT:
+    std::swap(LHSReg, RHSReg);
+    break;
+  }
+
+  unsigned DiffReg = LHSReg;
+  if (RHSReg)
+    DiffReg = fastEmitInst_rr(AAP::SUB_r, RC, LHSReg, false, RHSReg, false);
+  unsigned ResultReg = emitBorrow(DiffReg);
+  if (Invert)
+    ResultReg = fastEmitInst_ri(AAP::XORI_i9, RC, ResultReg, true, 1);
+
+  updateValueMap(I, ResultReg);
+  return true;
+}
+
+// Extend an i1 or i8 value to 16 bits
+unsigned AAPFastISel::emitIntExt(MVT SrcVT, unsigned SrcReg, bool IsZExt) {
+  const TargetRegisterClass *RC = &AAP::GR64RegClass;
+  if (IsZExt)
+    return fastEmitInst_ri(AAP::ANDI_i9, RC, SrcReg, false,
+                           SrcVT == MVT::i1 ? 0x1 : 0xff);
+
+  unsigned Shift = 16 - SrcVT.getSizeInBits();
+  unsigned ShlReg = fastEmitInst_ri(AAP::LSLI_i6, RC, SrcReg, false, Shift);
+  return fastEmitInst_ri(AAP::ASRI_i6, RC, ShlReg, true, Shift);
+}
+
+bool AAPFastISel::selectIntExt(const Instruction *I) {
+  MVT SrcVT, DestVT;
+  if (!isTypeSupported(I->getOperand(0)->getType(), SrcVT) ||
+      !isTypeSupported(I->getType(), DestVT) ||
+      SrcVT.getSizeInBits() >= DestVT.getSizeInBits())
+    return false;
+
+  unsigned SrcReg = getRegForValue(I->getOperand(0));
+  if (!SrcReg)
+    return false;
+
+  unsigned ResultReg = emitIntExt(SrcVT, SrcReg, isa<ZExtInst>(I));
+  if (!ResultReg)
+    return false;
+  updateValueMap(I, ResultReg);
+  return true;
+}
+
+// Truncation to i1 or i8 just leaves the upper bits undefined
+bool AAPFastISel::selectTrunc(const Instruction *I) {
+  MVT SrcVT, DestVT;
+  if (!isTypeLegal(I->getOperand(0)->getType(), SrcVT) ||
+      !isTypeSupported(I->getType(), DestVT))
+    return false;
+
+  unsigned SrcReg = getRegForValue(I->getOperand(0));
+  if (!SrcReg)
+    return false;
+  updateValueMap(I, SrcReg);
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Calling convention
+//===----------------------------------------------------------------------===//
+
+bool AAPFastISel::selectRet(const Instruction *I) {
+  const ReturnInst *Ret = cast<ReturnInst>(I);
+  const Function &F = *I->getParent()->getParent();
+  if (!FuncInfo.CanLowerReturn || F.isVarArg())
+    return false;
+
+  SmallVector<unsigned, 1> RetRegs;
+  if (Ret->getNumOperands() > 0) {
+    const Value *RV = Ret->getOperand(0);
+    MVT VT;
+    if (!isTypeSupported(RV->getType(), VT))
+      return false;
+
+    SmallVector<ISD::OutputArg, 1> Outs;
+    Outs.push_back(ISD::OutputArg(ISD::ArgFlagsTy(), MVT::i16, MVT::i16,
+                                  /*isfixed=*/true, 0, 0));
+    SmallVector<CCValAssign, 1> ValLocs;
+    CCState CCInfo(F.getCallingConv(), F.isVarArg(), *FuncInfo.MF, ValLocs,
+                   *Context);
+    CCInfo.AnalyzeReturn(Outs, getTargetLowering().CCAssignFnForReturn());
+    if (ValLocs.size() != 1 || !ValLocs[0].isRegLoc())
+      return false;
+    CCValAssign &VA = ValLocs[0];
+
+    unsigned Reg = getRegForValue(RV);
+    if (!Reg)
+      return false;
+
+    // Extend narrow return values as the attributes of the function require
+    if (VT != MVT::i16) {
+      bool IsZExt = F.getAttributes().hasAttribute(
+          AttributeList::ReturnIndex, Attribute::ZExt);
+      bool IsSExt = F.getAttributes().hasAttribute(
+          AttributeList::ReturnIndex, Attribute::SExt);
+      if (IsZExt || IsSExt)
+        Reg = emitIntExt(VT, Reg, IsZExt);
+      if (!Reg)
+        return false;
+    }
+
+    unsigned DestReg = VA.getLocReg();
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+            TII.get(TargetOpcode::COPY), DestReg)
+        .addReg(Reg);
+
+    // The return register is not preserved for the caller
+    FuncInfo.MF->getRegInfo().disableCalleeSavedRegister(DestReg);
+    RetRegs.push_back(DestReg);
+  }
+
+  MachineInstrBuilder MIB =
+      BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+              TII.get(AAP::PseudoRET));
+  for (unsigned Reg : RetRegs)
+    MIB.addReg(Reg, RegState::Implicit);
+  return true;
+}
+
+// Only simple functions with up to six word sized arguments, all passed in
+// registers, are handled.
+bool AAPFastISel::fastLowerArguments() {
+  if (!FuncInfo.CanLowerReturn)
+    return false;
+
+  const Function *F = FuncInfo.Fn;
+  if (F->isVarArg())
+    return false;
+
+  CallingConv::ID CC = F->getCallingConv();
+  if (CC != CallingConv::C && CC != CallingConv::Fast)
+    return false;
+
+  static const MCPhysReg ArgRegs[] = {AAP::R2, AAP::R3, AAP::R4,
+                                      AAP::R5, AAP::R6, AAP::R7};
+  if (F->arg_size() > array_lengthof(ArgRegs))
+    return false;
+
+  for (const Argument &Arg : F->args()) {
+    if (Arg.hasAttribute(Attribute::ByVal) ||
+        Arg.hasAttribute(Attribute::InReg) ||
+        Arg.hasAttribute(Attribute::StructRet) ||
+        Arg.hasAttribute(Attribute::Nest) ||
+        Arg.hasAttribute(Attribute::SwiftSelf) ||
+        Arg.hasAttribute(Attribute::SwiftError))
+      return false;
+
+    MVT VT;
+    if (!isTypeSupported(Arg.getType(), VT))
+      return false;
+  }
+
+  for (const Argument &Arg : F->args()) {
+    unsigned SrcReg = ArgRegs[Arg.getArgNo()];
+    unsigned DstReg = FuncInfo.MF->addLiveIn(SrcReg, &AAP::GR64RegClass);
+    // Copy out of the live in virtual register, so that the copy inserted
+    // for the live in is not removed if the argument is otherwise unused.
+    unsigned ResultReg = createResultReg(&AAP::GR64RegClass);
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+            TII.get(TargetOpcode::COPY), ResultReg)
+        .addReg(DstReg, getKillRegState(true));
+    updateValueMap(&Arg, ResultReg);
+  }
+  return true;
+}
+
+bool AAPFastISel::fastLowerCall(CallLoweringInfo &CLI) {
+  CallingConv::ID CC = CLI.CallConv;
+  if (CC != CallingConv::C && CC != CallingConv::Fast)
+    return false;
+
+  // Calls to runtime library symbols are left to SelectionDAG
+  if (CLI.Symbol)
+    return false;
+
+  MVT RetVT = MVT::isVoid;
+  if (!CLI.RetTy->isVoidTy() && !isTypeSupported(CLI.RetTy, RetVT))
+    return false;
+
+  for (ISD::ArgFlagsTy Flags : CLI.OutFlags) {
+    if (Flags.isInReg() || Flags.isSRet() || Flags.isNest() ||
+        Flags.isByVal() || Flags.isInConsecutiveRegs() ||
+        Flags.isSwiftSelf() || Flags.isSwiftError())
+      return false;
+  }
+
+  // Get the arguments, extended to 16 bits as the flags require
+  SmallVector<unsigned, 8> ArgRegs;
+  SmallVector<MVT, 8> ArgVTs;
+  for (unsigned i = 0, e = CLI.OutVals.size(); i != e; ++i) {
+    const Value *Val = CLI.OutVals[i];
+    MVT VT;
+    if (!isTypeSupported(Val->getType(), VT))
+      return false;
+
+    unsigned Reg = getRegForValue(Val);
+    if (!Reg)
+      return false;
+    if (VT != MVT::i16 && (CLI.OutFlags[i].isZExt() ||
+                           CLI.OutFlags[i].isSExt())) {
+      Reg = emitIntExt(VT, Reg, CLI.OutFlags[i].isZExt());
+      if (!Reg)
+        return false;
+    }
+    ArgRegs.push_back(Reg);
+    ArgVTs.push_back(MVT::i16);
+  }
+
+  SmallVector<CCValAssign, 16> ArgLocs;
+  CCState CCInfo(CC, CLI.IsVarArg, *FuncInfo.MF, ArgLocs, *Context);
+  CCInfo.AnalyzeCallOperands(ArgVTs, CLI.OutFlags,
+                             getTargetLowering().CCAssignFnForCall());
+
+  // Stack arguments are stored relative to the stack pointer
+  for (CCValAssign &VA : ArgLocs) {
+    if (VA.isMemLoc() && !AAP::isOff10(VA.getLocMemOffset()))
+      return false;
+  }
+
+  // The callee is either a global, called with BAL, or a register, called
+  // with JAL
+  const GlobalValue *GV = dyn_cast<GlobalValue>(CLI.Callee);
+  unsigned CalleeReg = 0;
+  if (!GV) {
+    CalleeReg = getRegForValue(CLI.Callee);
+    if (!CalleeReg)
+      return false;
+  }
+
+  unsigned NumBytes = CCInfo.getNextStackOffset();
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+          TII.get(TII.getCallFrameSetupOpcode()))
+      .addImm(NumBytes)
+      .addImm(0);
+
+  unsigned SP = AAPRegisterInfo::getStackPtrRegister();
+  for (unsigned i = 0, e = ArgLocs.size(); i != e; ++i) {
+    CCValAssign &VA = ArgLocs[i];
+    unsigned ArgReg = ArgRegs[VA.getValNo()];
+    if (VA.isRegLoc()) {
+      BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+              TII.get(TargetOpcode::COPY), VA.getLocReg())
+          .addReg(ArgReg);
+      CLI.OutRegs.push_back(VA.getLocReg());
+      continue;
+    }
+
+    unsigned Offset = VA.getLocMemOffset();
+    MachineMemOperand *MMO = FuncInfo.MF->getMachineMemOperand(
+        MachinePointerInfo::getStack(*FuncInfo.MF, Offset),
+        MachineMemOperand::MOStore, 2, 2);
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(AAP::STW))
+        .addReg(SP)
+        .addImm(Offset)
+        .addReg(ArgReg)
+        .addMemOperand(MMO);
+  }
+
+  // Analyze the return value, which must be in a single register
+  SmallVector<CCValAssign, 1> RVLocs;
+  if (RetVT != MVT::isVoid) {
+    CCState CCRetInfo(CC, CLI.IsVarArg, *FuncInfo.MF, RVLocs, *Context);
+    CCRetInfo.AnalyzeCallResult(MVT::i16,
+                                getTargetLowering().CCAssignFnForReturn());
+    if (RVLocs.size() != 1 || !RVLocs[0].isRegLoc())
+      return false;
+  }
+
+  // Issue the call, with the link register as the last operand
+  unsigned LinkReg = AAPRegisterInfo::getLinkRegister();
+  MachineInstrBuilder MIB;
+  if (GV) {
+    MIB = BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(AAP::BAL))
+              .addGlobalAddress(GV)
+              .addReg(LinkReg);
+  } else {
+    MIB = BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(AAP::JAL))
+              .addReg(CalleeReg)
+              .addReg(LinkReg);
+  }
+
+  for (unsigned Reg : CLI.OutRegs)
+    MIB.addReg(Reg, RegState::Implicit);
+
+  // The return register is clobbered by the call, so is removed from the
+  // mask of preserved registers
+  const TargetRegisterInfo &TRI = *Subtarget->getRegisterInfo();
+  const uint32_t *Mask = TRI.getCallPreservedMask(*FuncInfo.MF, CC);
+  uint32_t *RegMask = FuncInfo.MF->allocateRegMask();
+  unsigned RegMaskSize = MachineOperand::getRegMaskSize(TRI.getNumRegs());
+  memcpy(RegMask, Mask, sizeof(RegMask[0]) * RegMaskSize);
+  for (CCValAssign &VA : RVLocs) {
+    unsigned Reg = VA.getLocReg();
+    RegMask[Reg / 32] &= ~(1u << (Reg % 32));
+    MIB.addReg(Reg, RegState::ImplicitDefine);
+  }
+  MIB.addRegMask(RegMask);
+  CLI.Call = MIB;
+
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+          TII.get(TII.getCallFrameDestroyOpcode()))
+      .addImm(NumBytes)
+      .addImm(0);
+
+  // Copy the result out of the return register
+  if (RetVT != MVT::isVoid) {
+    unsigned ResultReg = createResultReg(&AAP::GR64RegClass);
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+            TII.get(TargetOpcode::COPY), ResultReg)
+        .addReg(RVLocs[0].getLocReg());
+    CLI.InRegs.push_back(RVLocs[0].getLocReg());
+    CLI.ResultReg = ResultReg;
+    CLI.NumResultRegs = 1;
+  }
+  return true;
+}
+
+namespace llvm {
+FastISel *AAP::createFastISel(FunctionLoweringInfo &FuncInfo,
+                              const TargetLibraryInfo *LibInfo) {
+  return new AAPFastISel(FuncInfo, LibInfo);
+}
+} // end namespace llvm
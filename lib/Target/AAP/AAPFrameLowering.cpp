@@ -16,6 +16,7 @@
 #include "AAPMachineFunctionInfo.h"
 #include "AAPSubtarget.h"
 #include "MCTargetDesc/AAPMCTargetDesc.h"
+#include "llvm/CodeGen/LivePhysRegs.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
@@ -38,8 +39,81 @@ AAPFrameLowering::AAPFrameLowering()
     : TargetFrameLowering(TargetFrameLowering::StackGrowsDown, 2, 0, 2) {}
 
 bool AAPFrameLowering::hasFP(const MachineFunction &MF) const {
+  const MachineFrameInfo &MFI = MF.getFrameInfo();
   return MF.getTarget().Options.DisableFramePointerElim(MF) ||
-         MF.getFrameInfo().hasVarSizedObjects();
+         MFI.hasVarSizedObjects() || MFI.isFrameAddressTaken();
+}
+
+// Outgoing arguments are stored in a reserved area at the bottom of the
+// frame, unless the stack pointer moves due to variable sized objects.
+bool AAPFrameLowering::hasReservedCallFrame(const MachineFunction &MF) const {
+  return !MF.getFrameInfo().hasVarSizedObjects();
+}
+
+bool AAPFrameLowering::enableShrinkWrapping(const MachineFunction &MF) const {
+  return true;
+}
+
+// Find a register which can hold a large stack adjustment before MBBI. The
+// register must not be live, and must not be callee saved since the callee
+// saved registers are not yet saved in the prologue, and already restored
+// in the epilogue. Returns zero if there is no such register.
+static unsigned findScratchRegister(MachineBasicBlock &MBB,
+                                    MachineBasicBlock::iterator MBBI) {
+  MachineFunction &MF = *MBB.getParent();
+  const TargetRegisterInfo &TRI = *MF.getSubtarget().getRegisterInfo();
+  const MachineRegisterInfo &MRI = MF.getRegInfo();
+
+  LivePhysRegs LiveRegs(TRI);
+  LiveRegs.addLiveOuts(MBB);
+  for (auto I = MBB.end(); I != MBBI;)
+    LiveRegs.stepBackward(*--I);
+
+  const MCPhysReg *CSRegs = TRI.getCalleeSavedRegs(&MF);
+  for (unsigned Reg : AAP::GR64RegClass) {
+    if (!LiveRegs.available(MRI, Reg))
+      continue;
+    bool IsCalleeSaved = false;
+    for (const MCPhysReg *CSR = CSRegs; *CSR; ++CSR)
+      IsCalleeSaved |= *CSR == Reg;
+    if (!IsCalleeSaved)
+      return Reg;
+  }
+  return 0;
+}
+
+// Add Amount to the stack pointer. Small amounts are added in steps which
+// fit in an immediate. Larger amounts are materialized in a scratch register
+// if one is available, which costs two instructions.
+static void adjustStackPtr(MachineBasicBlock &MBB,
+                           MachineBasicBlock::iterator MBBI,
+                           const DebugLoc &DL, const AAPInstrInfo &TII,
+                           int64_t Amount, bool AllowScratch) {
+  const unsigned SP = AAPRegisterInfo::getStackPtrRegister();
+  uint64_t NumBytes = Amount < 0 ? -Amount : Amount;
+
+  const uint64_t Addend = NumBytes % 1023;
+  const uint64_t NumChunks = NumBytes / 1023;
+
+  if (AllowScratch && NumChunks + (Addend ? 1 : 0) > 2) {
+    if (unsigned ScratchReg = findScratchRegister(MBB, MBBI)) {
+      BuildMI(MBB, MBBI, DL, TII.get(AAP::MOVI_i16), ScratchReg)
+          .addImm(NumBytes);
+      BuildMI(MBB, MBBI, DL, TII.get(Amount < 0 ? AAP::SUB_r : AAP::ADD_r),
+              SP)
+          .addReg(SP)
+          .addReg(ScratchReg, RegState::Kill);
+      return;
+    }
+  }
+
+  unsigned Opcode = Amount < 0 ? AAP::SUBI_i10 : AAP::ADDI_i10;
+  for (uint64_t i = 0; i < NumChunks; ++i) {
+    BuildMI(MBB, MBBI, DL, TII.get(Opcode), SP).addReg(SP).addImm(1023);
+  }
+  if (Addend) {
+    BuildMI(MBB, MBBI, DL, TII.get(Opcode), SP).addReg(SP).addImm(Addend);
+  }
 }
 
 void AAPFrameLowering::emitPrologue(MachineFunction &MF,
@@ -55,26 +129,31 @@ void AAPFrameLowering::emitPrologue(MachineFunction &MF,
   // Get the number of bytes to allocate from the FrameInfo
   const uint64_t StackSize = MFrameInfo.getStackSize();
 
-  assert(!hasFP(MF) && "Frame pointer unsupported!");
-
   uint64_t NumBytes = StackSize - MFuncInfo->getCalleeSavedFrameSize();
   const unsigned SP = AAPRegisterInfo::getStackPtrRegister();
 
+  if (hasFP(MF)) {
+    // Push the old frame pointer into its slot at the top of the frame, and
+    // point the frame pointer at the incoming stack pointer
+    const unsigned FP = AAPRegisterInfo::getFramePtrRegister();
+    BuildMI(MBB, MBBI, DL, TII.get(AAP::STW_predec))
+        .addReg(SP)
+        .addImm(2)
+        .addReg(FP)
+        .addReg(SP, RegState::ImplicitDefine);
+    BuildMI(MBB, MBBI, DL, TII.get(AAP::ADDI_i10), FP).addReg(SP).addImm(2);
+    NumBytes -= 2;
+  }
+
+  // Skip over the pushes of the callee saved registers, which have already
+  // allocated their part of the frame
+  while (MBBI != MBB.end() && MBBI->getOpcode() == AAP::STW_predec &&
+         MBBI->getFlag(MachineInstr::FrameSetup))
+    ++MBBI;
+
   // Adjust the stack pointer if there is a stack to allocate
   if (NumBytes) {
-    const uint64_t Addend = NumBytes % 1023;
-    const uint64_t NumChunks = NumBytes / 1023;
-
-    for (uint64_t i = 0; i < NumChunks; ++i) {
-      BuildMI(MBB, MBBI, DL, TII.get(AAP::SUBI_i10), SP)
-          .addReg(SP)
-          .addImm(1023);
-    }
-    if (Addend) {
-      BuildMI(MBB, MBBI, DL, TII.get(AAP::SUBI_i10), SP)
-          .addReg(SP)
-          .addImm(Addend);
-    }
+    adjustStackPtr(MBB, MBBI, DL, TII, -NumBytes, true);
   }
 }
 
@@ -85,36 +164,104 @@ void AAPFrameLowering::emitEpilogue(MachineFunction &MF,
   const AAPInstrInfo &TII =
       *static_cast<const AAPInstrInfo *>(MF.getSubtarget().getInstrInfo());
 
-  auto MBBI = MBB.getLastNonDebugInstr();
+  // With shrink wrapping, the epilogue may be inserted in a block which does
+  // not return, so insert it before the terminators
+  auto MBBI = MBB.getFirstTerminator();
   DebugLoc DL = MBBI != MBB.end() ? MBBI->getDebugLoc() : DebugLoc();
 
-  assert((MBBI->getDesc().isReturn()) &&
-         "Epilogue can only be inserted in returning blocks");
-
   // Number of bytes to dealloc from FrameInfo
   const uint64_t StackSize = MFrameInfo.getStackSize();
   uint64_t NumBytes = StackSize - MFuncInfo->getCalleeSavedFrameSize();
 
   const unsigned SP = AAPRegisterInfo::getStackPtrRegister();
 
-  assert(!hasFP(MF) && "Frame pointer unsupported!");
+  // Move back over the pops of the callee saved registers, which free their
+  // part of the frame
+  auto CSRestoreI = MBBI;
+  while (CSRestoreI != MBB.begin()) {
+    auto PrevI = std::prev(CSRestoreI);
+    if (PrevI->getOpcode() != AAP::LDW_postinc ||
+        !PrevI->getFlag(MachineInstr::FrameDestroy))
+      break;
+    CSRestoreI = PrevI;
+  }
+
+  if (hasFP(MF)) {
+    // The stack pointer may have moved, so restore it from the frame
+    // pointer, then pop the callee saved registers and the old frame pointer
+    const unsigned FP = AAPRegisterInfo::getFramePtrRegister();
+    BuildMI(MBB, CSRestoreI, DL, TII.get(AAP::SUBI_i10), SP)
+        .addReg(FP)
+        .addImm(2 + MFuncInfo->getCalleeSavedFrameSize());
+    BuildMI(MBB, MBBI, DL, TII.get(AAP::LDW_postinc), FP)
+        .addReg(SP)
+        .addImm(2)
+        .addReg(SP, RegState::ImplicitDefine);
+    return;
+  }
 
   if (NumBytes) {
     // otherwise adjust by adding back the frame size
-    const uint64_t Addend = NumBytes % 1023;
-    const uint64_t NumChunks = NumBytes / 1023;
+    adjustStackPtr(MBB, CSRestoreI, DL, TII, NumBytes, true);
+  }
+}
 
-    for (uint64_t i = 0; i < NumChunks; ++i) {
-      BuildMI(MBB, MBBI, DL, TII.get(AAP::ADDI_i10), SP)
-          .addReg(SP)
-          .addImm(1023);
-    }
-    if (Addend) {
-      BuildMI(MBB, MBBI, DL, TII.get(AAP::ADDI_i10), SP)
-          .addReg(SP)
-          .addImm(Addend);
-    }
+// Callee saved registers are pushed with pre-decrement stores in the order
+// of their frame slots, so that no separate stack adjustment or frame
+// offsets are needed. Registers in GR8 are later shortened by the peephole.
+bool AAPFrameLowering::spillCalleeSavedRegisters(
+    MachineBasicBlock &MBB, MachineBasicBlock::iterator MI,
+    const std::vector<CalleeSavedInfo> &CSI,
+    const TargetRegisterInfo *TRI) const {
+  if (CSI.empty())
+    return false;
+
+  MachineFunction &MF = *MBB.getParent();
+  const MachineRegisterInfo &MRI = MF.getRegInfo();
+  const TargetInstrInfo &TII = *MF.getSubtarget().getInstrInfo();
+  AAPMachineFunctionInfo *MFuncInfo = MF.getInfo<AAPMachineFunctionInfo>();
+  DebugLoc DL = MI != MBB.end() ? MI->getDebugLoc() : DebugLoc();
+
+  MFuncInfo->setCalleeSavedFrameSize(CSI.size() * 2);
+
+  const unsigned SP = AAPRegisterInfo::getStackPtrRegister();
+  for (const CalleeSavedInfo &Info : CSI) {
+    unsigned Reg = Info.getReg();
+
+    // Registers live into the function must not be killed by the push
+    bool IsLiveIn = MRI.isLiveIn(Reg);
+    if (!MBB.isLiveIn(Reg))
+      MBB.addLiveIn(Reg);
+
+    BuildMI(MBB, MI, DL, TII.get(AAP::STW_predec))
+        .addReg(SP)
+        .addImm(2)
+        .addReg(Reg, getKillRegState(!IsLiveIn))
+        .addReg(SP, RegState::ImplicitDefine)
+        .setMIFlag(MachineInstr::FrameSetup);
+  }
+  return true;
+}
+
+bool AAPFrameLowering::restoreCalleeSavedRegisters(
+    MachineBasicBlock &MBB, MachineBasicBlock::iterator MI,
+    std::vector<CalleeSavedInfo> &CSI, const TargetRegisterInfo *TRI) const {
+  if (CSI.empty())
+    return false;
+
+  MachineFunction &MF = *MBB.getParent();
+  const TargetInstrInfo &TII = *MF.getSubtarget().getInstrInfo();
+  DebugLoc DL = MI != MBB.end() ? MI->getDebugLoc() : DebugLoc();
+
+  const unsigned SP = AAPRegisterInfo::getStackPtrRegister();
+  for (auto I = CSI.rbegin(), E = CSI.rend(); I != E; ++I) {
+    BuildMI(MBB, MI, DL, TII.get(AAP::LDW_postinc), I->getReg())
+        .addReg(SP)
+        .addImm(2)
+        .addReg(SP, RegState::ImplicitDefine)
+        .setMIFlag(MachineInstr::FrameDestroy);
   }
+  return true;
 }
 
 // This function eliminates ADJCALLSTACKDOWN,
@@ -122,10 +269,26 @@ void AAPFrameLowering::emitEpilogue(MachineFunction &MF,
 MachineBasicBlock::iterator AAPFrameLowering::eliminateCallFramePseudoInstr(
     MachineFunction &MF, MachineBasicBlock &MBB,
     MachineBasicBlock::iterator I) const {
-  // FIXME: Implement frame pointer support
-  assert(!hasFP(MF) && "Frame pointer unsupported!");
+  if (!hasReservedCallFrame(MF)) {
+    const AAPInstrInfo &TII =
+        *static_cast<const AAPInstrInfo *>(MF.getSubtarget().getInstrInfo());
+
+    // Allocate or free the outgoing arguments around the call, keeping the
+    // stack aligned
+    int64_t Amount = alignTo(I->getOperand(0).getImm(), getStackAlignment());
+    if (Amount) {
+      if (I->getOpcode() == AAP::ADJCALLSTACKDOWN)
+        Amount = -Amount;
+      adjustStackPtr(MBB, I, I->getDebugLoc(), TII, Amount, false);
+    }
+  }
   return MBB.erase(I);
 }
 
 void AAPFrameLowering::processFunctionBeforeFrameFinalized(
-    MachineFunction &MF, RegScavenger *RS) const {}
+    MachineFunction &MF, RegScavenger *RS) const {
+  // Reserve the slot at the top of the frame where the old frame pointer is
+  // saved by the prologue
+  if (hasFP(MF))
+    MF.getFrameInfo().CreateFixedObject(2, -2, true);
+}
@@ -49,9 +49,18 @@ class AAPDAGToDAGISel : public SelectionDAGISel {
   /// TM - Keep a reference to AAPTargetMachine.
   AAPTargetMachine &TM;
 
+  /// Subtarget - The subtarget of the function being selected, used by the
+  /// instruction predicates.
+  const AAPSubtarget *Subtarget;
+
 public:
   AAPDAGToDAGISel(AAPTargetMachine &tm, CodeGenOpt::Level OptLevel)
-      : SelectionDAGISel(tm), TM(tm) {}
+      : SelectionDAGISel(tm), TM(tm), Subtarget(nullptr) {}
+
+  bool runOnMachineFunction(MachineFunction &MF) override {
+    Subtarget = &MF.getSubtarget<AAPSubtarget>();
+    return SelectionDAGISel::runOnMachineFunction(MF);
+  }
 
   // Pass Name
   virtual StringRef getPassName() const override {
@@ -73,6 +82,10 @@ private:
 
   void Select(SDNode *N) override;
 
+  // Indexed load and store selection.
+  bool tryIndexedLoad(SDNode *N);
+  bool tryIndexedStore(SDNode *N);
+
   // Complex Pattern for address selection.
   bool SelectAddr(SDValue Addr, SDValue &Base, SDValue &Offset);
   bool SelectAddr_MO3(SDValue Addr, SDValue &Base, SDValue &Offset);
@@ -133,6 +146,14 @@ void AAPDAGToDAGISel::Select(SDNode *Node) {
     ReplaceNode(Node, N);
     return;
   }
+  case ISD::LOAD:
+    if (tryIndexedLoad(Node))
+      return;
+    break;
+  case ISD::STORE:
+    if (tryIndexedStore(Node))
+      return;
+    break;
   default:
     break;
   }
@@ -141,6 +162,83 @@ void AAPDAGToDAGISel::Select(SDNode *Node) {
   SelectCode(Node);
 }
 
+// Select a pre-decrement or post-increment load, which also produces the
+// updated base register.
+bool AAPDAGToDAGISel::tryIndexedLoad(SDNode *N) {
+  LoadSDNode *LD = cast<LoadSDNode>(N);
+  ISD::MemIndexedMode AM = LD->getAddressingMode();
+  if (AM == ISD::UNINDEXED)
+    return false;
+  assert((AM == ISD::PRE_DEC || AM == ISD::POST_INC) &&
+         "Unexpected indexed addressing mode");
+
+  bool isPreDec = AM == ISD::PRE_DEC;
+  unsigned Opcode;
+  switch (LD->getMemoryVT().getSimpleVT().SimpleTy) {
+  default:
+    return false;
+  case MVT::i8:
+    // LDB zero extends
+    if (LD->getExtensionType() == ISD::SEXTLOAD)
+      return false;
+    Opcode = isPreDec ? AAP::LDB_predec_wb : AAP::LDB_postinc_wb;
+    break;
+  case MVT::i16:
+    Opcode = isPreDec ? AAP::LDW_predec_wb : AAP::LDW_postinc_wb;
+    break;
+  }
+
+  SDLoc dl(N);
+  int64_t Offset = cast<ConstantSDNode>(LD->getOffset())->getSExtValue();
+  SDValue Ops[] = {LD->getBasePtr(),
+                   CurDAG->getTargetConstant(Offset, dl, MVT::i16),
+                   LD->getChain()};
+  MachineSDNode *New = CurDAG->getMachineNode(Opcode, dl, MVT::i16, MVT::i16,
+                                              MVT::Other, Ops);
+  MachineSDNode::mmo_iterator MemRefs = MF->allocateMemRefsArray(1);
+  MemRefs[0] = LD->getMemOperand();
+  New->setMemRefs(MemRefs, MemRefs + 1);
+  ReplaceNode(N, New);
+  return true;
+}
+
+// Select a pre-decrement or post-increment store, which produces the updated
+// base register.
+bool AAPDAGToDAGISel::tryIndexedStore(SDNode *N) {
+  StoreSDNode *ST = cast<StoreSDNode>(N);
+  ISD::MemIndexedMode AM = ST->getAddressingMode();
+  if (AM == ISD::UNINDEXED)
+    return false;
+  assert((AM == ISD::PRE_DEC || AM == ISD::POST_INC) &&
+         "Unexpected indexed addressing mode");
+
+  bool isPreDec = AM == ISD::PRE_DEC;
+  unsigned Opcode;
+  switch (ST->getMemoryVT().getSimpleVT().SimpleTy) {
+  default:
+    return false;
+  case MVT::i8:
+    Opcode = isPreDec ? AAP::STB_predec_wb : AAP::STB_postinc_wb;
+    break;
+  case MVT::i16:
+    Opcode = isPreDec ? AAP::STW_predec_wb : AAP::STW_postinc_wb;
+    break;
+  }
+
+  SDLoc dl(N);
+  int64_t Offset = cast<ConstantSDNode>(ST->getOffset())->getSExtValue();
+  SDValue Ops[] = {ST->getBasePtr(),
+                   CurDAG->getTargetConstant(Offset, dl, MVT::i16),
+                   ST->getValue(), ST->getChain()};
+  MachineSDNode *New =
+      CurDAG->getMachineNode(Opcode, dl, MVT::i16, MVT::Other, Ops);
+  MachineSDNode::mmo_iterator MemRefs = MF->allocateMemRefsArray(1);
+  MemRefs[0] = ST->getMemOperand();
+  New->setMemRefs(MemRefs, MemRefs + 1);
+  ReplaceNode(N, New);
+  return true;
+}
+
 bool AAPDAGToDAGISel::SelectAddr(SDValue Addr, SDValue &Base, SDValue &Offset) {
   // if Address is FI, get the TargetFrameIndex
   if (FrameIndexSDNode *FIN = dyn_cast<FrameIndexSDNode>(Addr)) {
@@ -20,6 +20,7 @@
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineJumpTableInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/SelectionDAGISel.h"
 #include "llvm/CodeGen/TargetLoweringObjectFileImpl.h"
@@ -38,6 +39,11 @@ using namespace llvm;
 
 #define DEBUG_TYPE "aap-lower"
 
+static cl::opt<unsigned> BranchlessSelectCost(
+    "aap-branchless-select-cost", cl::Hidden, cl::init(5),
+    cl::desc("Maximum number of instructions for a select to be lowered "
+             "without a branch"));
+
 AAPTargetLowering::AAPTargetLowering(const TargetMachine &TM,
                                      const AAPSubtarget &STI)
     : TargetLowering(TM), Subtarget(STI) {
@@ -64,6 +70,17 @@ AAPTargetLowering::AAPTargetLowering(const TargetMachine &TM,
   setOperationAction(ISD::GlobalAddress, MVT::i16, Custom);
   setOperationAction(ISD::ExternalSymbol, MVT::i16, Custom);
   setOperationAction(ISD::BlockAddress, MVT::i16, Custom);
+  setOperationAction(ISD::JumpTable, MVT::i16, Custom);
+
+  // Loads and stores may pre-decrement or post-increment their base register.
+  // The offsets are signed, so pre-increment and post-decrement accesses are
+  // formed by negating the offset.
+  for (MVT VT : {MVT::i8, MVT::i16}) {
+    setIndexedLoadAction(ISD::PRE_DEC, VT, Legal);
+    setIndexedLoadAction(ISD::POST_INC, VT, Legal);
+    setIndexedStoreAction(ISD::PRE_DEC, VT, Legal);
+    setIndexedStoreAction(ISD::POST_INC, VT, Legal);
+  }
 
   setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::i1, Expand);
   setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::i8, Expand);
@@ -83,37 +100,53 @@ AAPTargetLowering::AAPTargetLowering(const TargetMachine &TM,
   setCondCodeAction(ISD::SETUGT, MVT::i16, Expand);
   setCondCodeAction(ISD::SETUGE, MVT::i16, Expand);
 
-  // BR_JT unsupported by the architecture
+  // Jump tables are lowered to a load of the destination from the table,
+  // followed by an indirect jump
   setOperationAction(ISD::BR_JT, MVT::Other, Expand);
 
+  // Variable sized allocations move the stack pointer
+  setOperationAction(ISD::DYNAMIC_STACKALLOC, MVT::i16, Expand);
+  setOperationAction(ISD::STACKSAVE, MVT::Other, Expand);
+  setOperationAction(ISD::STACKRESTORE, MVT::Other, Expand);
+  setOperationAction(ISD::FRAMEADDR, MVT::i16, Custom);
+
   // vaarg
   setOperationAction(ISD::VASTART, MVT::Other, Custom);
   setOperationAction(ISD::VAARG, MVT::Other, Expand);
   setOperationAction(ISD::VAEND, MVT::Other, Expand);
   setOperationAction(ISD::VACOPY, MVT::Other, Expand);
 
-  // ALU operations unsupported by the architecture
-  setOperationAction(ISD::SDIV, MVT::i16, Expand);
-  setOperationAction(ISD::UDIV, MVT::i16, Expand);
-  setOperationAction(ISD::UREM, MVT::i16, Expand);
-  setOperationAction(ISD::SREM, MVT::i16, Expand);
+  // Multiply and divide are only supported with the multiply and divide
+  // unit, otherwise they are library calls
+  LegalizeAction MulDivAction = STI.hasMulDiv() ? Legal : Expand;
+  setOperationAction(ISD::SDIV, MVT::i16, MulDivAction);
+  setOperationAction(ISD::UDIV, MVT::i16, MulDivAction);
+  setOperationAction(ISD::UREM, MVT::i16, MulDivAction);
+  setOperationAction(ISD::SREM, MVT::i16, MulDivAction);
   setOperationAction(ISD::SDIVREM, MVT::i16, Expand);
   setOperationAction(ISD::UDIVREM, MVT::i16, Expand);
 
-  setOperationAction(ISD::MUL, MVT::i16, Expand);
-  setOperationAction(ISD::MULHS, MVT::i16, Expand);
-  setOperationAction(ISD::MULHU, MVT::i16, Expand);
+  setOperationAction(ISD::MUL, MVT::i16, MulDivAction);
+  setOperationAction(ISD::MULHS, MVT::i16, MulDivAction);
+  setOperationAction(ISD::MULHU, MVT::i16, MulDivAction);
   setOperationAction(ISD::SMUL_LOHI, MVT::i16, Expand);
   setOperationAction(ISD::UMUL_LOHI, MVT::i16, Expand);
 
-  // Use ADDE/SUBE
-  setOperationAction(ISD::SUBC, MVT::i16, Expand);
+  // Wide additions and subtractions are chained through the carry flag, with
+  // ADD/SUB producing the carry and ADDC/SUBC consuming it.
+  setOperationAction(ISD::ADDC, MVT::i16, Legal);
+  setOperationAction(ISD::ADDE, MVT::i16, Legal);
+  setOperationAction(ISD::SUBC, MVT::i16, Legal);
+  setOperationAction(ISD::SUBE, MVT::i16, Legal);
 
   setOperationAction(ISD::ROTL, MVT::i16, Expand);
   setOperationAction(ISD::ROTR, MVT::i16, Expand);
-  setOperationAction(ISD::SHL_PARTS, MVT::i16, Expand);
-  setOperationAction(ISD::SRL_PARTS, MVT::i16, Expand);
-  setOperationAction(ISD::SRA_PARTS, MVT::i16, Expand);
+
+  // Wide shifts by a variable amount are lowered inline rather than calling
+  // the runtime library. Shifts by a constant are expanded by the legalizer.
+  setOperationAction(ISD::SHL_PARTS, MVT::i16, Custom);
+  setOperationAction(ISD::SRL_PARTS, MVT::i16, Custom);
+  setOperationAction(ISD::SRA_PARTS, MVT::i16, Custom);
 
   setOperationAction(ISD::BSWAP, MVT::i16, Expand);
   setOperationAction(ISD::CTTZ, MVT::i16, Expand);
@@ -126,12 +159,20 @@ AAPTargetLowering::AAPTargetLowering(const TargetMachine &TM,
 
   // Custom DAGCombine
   setTargetDAGCombine(ISD::ADD);
+  if (!STI.hasMulDiv())
+    setTargetDAGCombine(ISD::MUL);
 
   setMinFunctionAlignment(1);
   setPrefFunctionAlignment(2);
 
-  // No support for jump tables
-  setMinimumJumpTableEntries(INT_MAX);
+  // Inline copies and fills of up to this many stores. Larger ones are
+  // emitted as word loops by AAPSelectionDAGInfo where possible.
+  MaxStoresPerMemcpy = 8;
+  MaxStoresPerMemcpyOptSize = 4;
+  MaxStoresPerMemmove = 8;
+  MaxStoresPerMemmoveOptSize = 4;
+  MaxStoresPerMemset = 8;
+  MaxStoresPerMemsetOptSize = 4;
 }
 
 const char *AAPTargetLowering::getTargetNodeName(unsigned Opcode) const {
@@ -146,6 +187,12 @@ const char *AAPTargetLowering::getTargetNodeName(unsigned Opcode) const {
     return "AAPISD::Wrapper";
   case AAPISD::SELECT_CC:
     return "AAPISD::SELECT_CC";
+  case AAPISD::MEMCPY:
+    return "AAPISD::MEMCPY";
+  case AAPISD::MEMMOVE:
+    return "AAPISD::MEMMOVE";
+  case AAPISD::MEMSET:
+    return "AAPISD::MEMSET";
   }
 }
 
@@ -166,6 +213,8 @@ SDValue AAPTargetLowering::PerformDAGCombine(SDNode *N,
   switch (N->getOpcode()) {
   case ISD::ADD:
     return PerformADDCombine(N, DCI);
+  case ISD::MUL:
+    return PerformMULCombine(N, DCI);
   default:
     break;
   }
@@ -197,6 +246,137 @@ SDValue AAPTargetLowering::PerformADDCombine(SDNode *N,
   return SDValue(N, 0);
 }
 
+// The largest number of shifted terms a multiply by a constant is expanded
+// into. Each term costs a shift and an add or subtract, which is still far
+// cheaper than a call to __mulhi3.
+static const unsigned MaxMulTerms = 4;
+
+SDValue AAPTargetLowering::PerformMULCombine(SDNode *N,
+                                             DAGCombinerInfo &DCI) const {
+  SelectionDAG &DAG = DCI.DAG;
+
+  // Without a multiplier, expand multiplies by a constant into a sequence
+  // of shifts and adds.
+  EVT VT = N->getValueType(0);
+  ConstantSDNode *Const = dyn_cast<ConstantSDNode>(N->getOperand(1));
+  if (VT != MVT::i16 || !Const)
+    return SDValue();
+
+  // Find the non-adjacent form of the constant. This has the fewest non-zero
+  // digits of any signed binary representation, each of which is +1 or -1.
+  SmallVector<std::pair<unsigned, int>, MaxMulTerms> Terms;
+  int32_t Value = Const->getSExtValue();
+  for (unsigned Shift = 0; Value != 0; ++Shift) {
+    if (Value & 1) {
+      int Digit = (Value & 3) == 1 ? 1 : -1;
+      if (Terms.size() == MaxMulTerms)
+        return SDValue();
+      Terms.push_back(std::make_pair(Shift, Digit));
+      Value -= Digit;
+    }
+    Value /= 2;
+  }
+
+  // Sum the terms from the most significant, which is positive if the
+  // constant is positive.
+  SDLoc DL(N);
+  SDValue X = N->getOperand(0);
+  SDValue Res;
+  for (auto I = Terms.rbegin(), E = Terms.rend(); I != E; ++I) {
+    SDValue Term = X;
+    if (I->first)
+      Term = DAG.getNode(ISD::SHL, DL, VT, X,
+                         DAG.getConstant(I->first, DL, MVT::i16));
+    if (!Res)
+      Res = I->second > 0 ? Term
+                          : DAG.getNode(ISD::SUB, DL, VT,
+                                        DAG.getConstant(0, DL, VT), Term);
+    else
+      Res = DAG.getNode(I->second > 0 ? ISD::ADD : ISD::SUB, DL, VT, Res,
+                        Term);
+  }
+  if (!Res)
+    return DAG.getConstant(0, DL, VT);
+  return Res;
+}
+
+//===----------------------------------------------------------------------===//
+//                      Indexed Addressing Implementation
+//===----------------------------------------------------------------------===//
+
+// Get the pointer of a load or store which may be converted to an indexed
+// access.
+static bool getIndexedAccessPtr(SDNode *N, SDValue &Ptr) {
+  EVT VT;
+  if (LoadSDNode *LD = dyn_cast<LoadSDNode>(N)) {
+    // Byte loads zero extend
+    if (LD->getExtensionType() == ISD::SEXTLOAD)
+      return false;
+    VT = LD->getMemoryVT();
+    Ptr = LD->getBasePtr();
+  } else if (StoreSDNode *ST = dyn_cast<StoreSDNode>(N)) {
+    VT = ST->getMemoryVT();
+    Ptr = ST->getBasePtr();
+  } else {
+    return false;
+  }
+  return VT == MVT::i8 || VT == MVT::i16;
+}
+
+// Get the signed displacement of an add or subtract of a constant
+static bool getIndexedDisplacement(SDNode *Op, int64_t &Disp) {
+  if (Op->getOpcode() != ISD::ADD && Op->getOpcode() != ISD::SUB)
+    return false;
+  ConstantSDNode *C = dyn_cast<ConstantSDNode>(Op->getOperand(1));
+  if (!C)
+    return false;
+  Disp = C->getSExtValue();
+  if (Op->getOpcode() == ISD::SUB)
+    Disp = -Disp;
+  return true;
+}
+
+bool AAPTargetLowering::getPreIndexedAddressParts(SDNode *N, SDValue &Base,
+                                                  SDValue &Offset,
+                                                  ISD::MemIndexedMode &AM,
+                                                  SelectionDAG &DAG) const {
+  SDValue Ptr;
+  int64_t Disp;
+  if (!getIndexedAccessPtr(N, Ptr) ||
+      !getIndexedDisplacement(Ptr.getNode(), Disp))
+    return false;
+
+  // Only pre-decrement is supported, so the offset is the negated
+  // displacement
+  if (!AAP::isOff10(-Disp))
+    return false;
+
+  Base = Ptr->getOperand(0);
+  Offset = DAG.getConstant(-Disp, SDLoc(N), MVT::i16);
+  AM = ISD::PRE_DEC;
+  return true;
+}
+
+bool AAPTargetLowering::getPostIndexedAddressParts(SDNode *N, SDNode *Op,
+                                                   SDValue &Base,
+                                                   SDValue &Offset,
+                                                   ISD::MemIndexedMode &AM,
+                                                   SelectionDAG &DAG) const {
+  SDValue Ptr;
+  int64_t Disp;
+  if (!getIndexedAccessPtr(N, Ptr) || !getIndexedDisplacement(Op, Disp))
+    return false;
+
+  // The updated base must be derived from the pointer of the access
+  if (Op->getOperand(0) != Ptr || !AAP::isOff10(Disp))
+    return false;
+
+  Base = Ptr;
+  Offset = DAG.getConstant(Disp, SDLoc(N), MVT::i16);
+  AM = ISD::POST_INC;
+  return true;
+}
+
 //===----------------------------------------------------------------------===//
 //                       Custom Lowering Implementation
 //===----------------------------------------------------------------------===//
@@ -209,14 +389,23 @@ SDValue AAPTargetLowering::LowerOperation(SDValue Op, SelectionDAG &DAG) const {
     return LowerExternalSymbol(Op, DAG);
   case ISD::BlockAddress:
     return LowerBlockAddress(Op, DAG);
+  case ISD::JumpTable:
+    return LowerJumpTable(Op, DAG);
   case ISD::BR_CC:
     return LowerBR_CC(Op, DAG);
   case ISD::SELECT_CC:
     return LowerSELECT_CC(Op, DAG);
+  case ISD::SHL_PARTS:
+    return LowerShiftLeftParts(Op, DAG);
+  case ISD::SRL_PARTS:
+  case ISD::SRA_PARTS:
+    return LowerShiftRightParts(Op, DAG, Op.getOpcode() == ISD::SRA_PARTS);
   case ISD::VASTART:
     return LowerVASTART(Op, DAG);
   case ISD::RETURNADDR:
     return LowerRETURNADDR(Op, DAG);
+  case ISD::FRAMEADDR:
+    return LowerFRAMEADDR(Op, DAG);
   }
   llvm_unreachable("unimplemented operand");
 }
@@ -274,7 +463,146 @@ SDValue AAPTargetLowering::LowerBR_CC(SDValue Op, SelectionDAG &DAG) const {
   return DAG.getNode(AAPISD::BR_CC, DL, Op.getValueType(), Ops);
 }
 
+// Number of instructions needed to get Op into a register for an instruction
+// which can take an unsigned immediate of the given size.
+static unsigned getOperandCost(SDValue Op, unsigned ImmBits) {
+  ConstantSDNode *C = dyn_cast<ConstantSDNode>(Op);
+  if (!C)
+    return 0;
+  return isUIntN(ImmBits, C->getZExtValue()) ? 0 : 1;
+}
+
+// Produce a mask which is all ones if LHS is less than RHS, unsigned. The
+// borrow from subtracting RHS from LHS is turned into a mask by subtracting
+// the difference from itself with borrow.
+static SDValue getULTMask(SDValue LHS, SDValue RHS, const SDLoc &DL,
+                          SelectionDAG &DAG) {
+  SDVTList VTs = DAG.getVTList(MVT::i16, MVT::Glue);
+  SDValue Diff = DAG.getNode(ISD::SUBC, DL, VTs, LHS, RHS);
+  return DAG.getNode(ISD::SUBE, DL, VTs, Diff, Diff, Diff.getValue(1));
+}
+
+/// LowerSELECT_CCBranchless - Try to lower a select as a mask and merge,
+/// with the mask computed from the carry flag. Returns an empty SDValue if
+/// this is expected to be more expensive than a branch.
+SDValue AAPTargetLowering::LowerSELECT_CCBranchless(SDValue Op,
+                                                    SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  EVT VT = Op.getValueType();
+
+  SDValue LHS = Op.getOperand(0);
+  SDValue RHS = Op.getOperand(1);
+  SDValue TrueValue = Op.getOperand(2);
+  SDValue FalseValue = Op.getOperand(3);
+  ISD::CondCode CC = cast<CondCodeSDNode>(Op.getOperand(4))->get();
+
+  // A select on a boolean which is itself a compare, such as the expanded
+  // overflow of an unsigned add, uses the compare directly
+  if ((CC == ISD::SETNE || CC == ISD::SETEQ) && isNullConstant(RHS) &&
+      LHS.getOpcode() == ISD::SELECT_CC && isOneConstant(LHS.getOperand(2)) &&
+      isNullConstant(LHS.getOperand(3))) {
+    ISD::CondCode InnerCC = cast<CondCodeSDNode>(LHS.getOperand(4))->get();
+    if (CC == ISD::SETEQ)
+      InnerCC = ISD::getSetCCInverse(InnerCC, true);
+    CC = InnerCC;
+    RHS = LHS.getOperand(1);
+    LHS = LHS.getOperand(0);
+  }
+
+  // Canonicalize the condition to one of LT, ULT or EQ, with the result
+  // inverted if needed
+  bool Invert = false;
+  switch (CC) {
+  default:
+    return SDValue();
+  case ISD::SETNE:
+    Invert = true;
+    CC = ISD::SETEQ;
+    break;
+  case ISD::SETEQ:
+  case ISD::SETLT:
+  case ISD::SETULT:
+    break;
+  case ISD::SETGE:
+  case ISD::SETUGE:
+    Invert = true;
+    CC = ISD::getSetCCInverse(CC, true);
+    break;
+  case ISD::SETGT:
+  case ISD::SETUGT:
+    std::swap(LHS, RHS);
+    CC = ISD::getSetCCSwappedOperands(CC);
+    break;
+  case ISD::SETLE:
+  case ISD::SETULE:
+    std::swap(LHS, RHS);
+    Invert = true;
+    CC = ISD::getSetCCInverse(ISD::getSetCCSwappedOperands(CC), true);
+    break;
+  }
+  if (Invert)
+    std::swap(TrueValue, FalseValue);
+
+  // Cost of the mask, and of merging the values with it
+  unsigned Cost = 0;
+  bool IsSignBitTest = CC == ISD::SETLT && isNullConstant(RHS);
+  if (IsSignBitTest) {
+    Cost += 1;
+  } else if (CC == ISD::SETEQ) {
+    Cost += (isNullConstant(RHS) ? 2 : 3) + getOperandCost(RHS, 9);
+  } else {
+    // The subtract has no immediate form for its first operand, so any
+    // constant LHS, including zero, has to be put in a register. A signed
+    // compare flips zero to the sign bit, which is already in a register.
+    Cost += 2 + getOperandCost(RHS, 10);
+    if (isa<ConstantSDNode>(LHS) && !(CC == ISD::SETLT && isNullConstant(LHS)))
+      Cost += 1;
+    if (CC == ISD::SETLT) {
+      // Flip the sign bits to compare as unsigned
+      Cost += 1 + !isa<ConstantSDNode>(LHS) + !isa<ConstantSDNode>(RHS);
+    }
+  }
+
+  if (isNullConstant(FalseValue) || isAllOnesConstant(TrueValue))
+    Cost += 1;
+  else if (isNullConstant(TrueValue))
+    Cost += 2;
+  else
+    Cost += 3;
+  if (!isAllOnesConstant(TrueValue))
+    Cost += getOperandCost(TrueValue, 9) + getOperandCost(FalseValue, 9);
+
+  if (Cost > BranchlessSelectCost)
+    return SDValue();
+
+  SDValue Mask;
+  if (IsSignBitTest) {
+    Mask = DAG.getNode(ISD::SRA, DL, VT, LHS, DAG.getConstant(15, DL, VT));
+  } else if (CC == ISD::SETEQ) {
+    SDValue Diff = DAG.getNode(ISD::XOR, DL, VT, LHS, RHS);
+    Mask = getULTMask(Diff, DAG.getConstant(1, DL, VT), DL, DAG);
+  } else {
+    if (CC == ISD::SETLT) {
+      SDValue SignBit = DAG.getConstant(0x8000, DL, VT);
+      LHS = DAG.getNode(ISD::XOR, DL, VT, LHS, SignBit);
+      RHS = DAG.getNode(ISD::XOR, DL, VT, RHS, SignBit);
+    }
+    Mask = getULTMask(LHS, RHS, DL, DAG);
+  }
+
+  if (isAllOnesConstant(TrueValue))
+    return DAG.getNode(ISD::OR, DL, VT, FalseValue, Mask);
+
+  // FalseValue ^ ((TrueValue ^ FalseValue) & Mask)
+  SDValue Diff = DAG.getNode(ISD::XOR, DL, VT, TrueValue, FalseValue);
+  SDValue Masked = DAG.getNode(ISD::AND, DL, VT, Diff, Mask);
+  return DAG.getNode(ISD::XOR, DL, VT, FalseValue, Masked);
+}
+
 SDValue AAPTargetLowering::LowerSELECT_CC(SDValue Op, SelectionDAG &DAG) const {
+  if (SDValue Branchless = LowerSELECT_CCBranchless(Op, DAG))
+    return Branchless;
+
   SDLoc DL(Op);
 
   SDValue LHS = Op.getOperand(0);
@@ -291,6 +619,88 @@ SDValue AAPTargetLowering::LowerSELECT_CC(SDValue Op, SelectionDAG &DAG) const {
   return DAG.getNode(AAPISD::SELECT_CC, DL, Op.getValueType(), Ops);
 }
 
+// The shift amount is masked to its low four bits, so each part is shifted by
+// the amount modulo 16, which is correct for either half of the range of the
+// wide shift. The result for each half is then selected on bit 4 of the
+// amount.
+SDValue AAPTargetLowering::LowerShiftLeftParts(SDValue Op,
+                                               SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  SDValue Lo = Op.getOperand(0);
+  SDValue Hi = Op.getOperand(1);
+  SDValue Shamt = Op.getOperand(2);
+  EVT VT = Lo.getValueType();
+
+  // if Shamt < 16:
+  //   Lo = Lo << Shamt
+  //   Hi = (Hi << Shamt) | ((Lo >>u 1) >>u (15 - Shamt))
+  // else:
+  //   Lo = 0
+  //   Hi = Lo << (Shamt - 16)
+  SDValue Zero = DAG.getConstant(0, DL, VT);
+  SDValue One = DAG.getConstant(1, DL, VT);
+  SDValue Amt = DAG.getNode(ISD::AND, DL, VT, Shamt,
+                            DAG.getConstant(15, DL, VT));
+  SDValue InvAmt = DAG.getNode(ISD::XOR, DL, VT, Amt,
+                               DAG.getConstant(15, DL, VT));
+  SDValue IsWide = DAG.getNode(ISD::AND, DL, VT, Shamt,
+                               DAG.getConstant(16, DL, VT));
+
+  SDValue ShiftedLo = DAG.getNode(ISD::SHL, DL, VT, Lo, Amt);
+  SDValue ShiftedHi = DAG.getNode(ISD::SHL, DL, VT, Hi, Amt);
+  SDValue Carried = DAG.getNode(ISD::SRL, DL, VT,
+                                DAG.getNode(ISD::SRL, DL, VT, Lo, One), InvAmt);
+  SDValue NarrowHi = DAG.getNode(ISD::OR, DL, VT, ShiftedHi, Carried);
+
+  SDValue NewLo =
+      DAG.getSelectCC(DL, IsWide, Zero, Zero, ShiftedLo, ISD::SETNE);
+  SDValue NewHi =
+      DAG.getSelectCC(DL, IsWide, Zero, ShiftedLo, NarrowHi, ISD::SETNE);
+  SDValue Parts[] = {NewLo, NewHi};
+  return DAG.getMergeValues(Parts, DL);
+}
+
+SDValue AAPTargetLowering::LowerShiftRightParts(SDValue Op, SelectionDAG &DAG,
+                                                bool IsSRA) const {
+  SDLoc DL(Op);
+  SDValue Lo = Op.getOperand(0);
+  SDValue Hi = Op.getOperand(1);
+  SDValue Shamt = Op.getOperand(2);
+  EVT VT = Lo.getValueType();
+  unsigned ShiftOpc = IsSRA ? ISD::SRA : ISD::SRL;
+
+  // if Shamt < 16:
+  //   Lo = (Lo >>u Shamt) | ((Hi << 1) << (15 - Shamt))
+  //   Hi = Hi >> Shamt
+  // else:
+  //   Lo = Hi >> (Shamt - 16)
+  //   Hi = Hi >>s 15 for SRA, or 0 for SRL
+  SDValue Zero = DAG.getConstant(0, DL, VT);
+  SDValue One = DAG.getConstant(1, DL, VT);
+  SDValue Amt = DAG.getNode(ISD::AND, DL, VT, Shamt,
+                            DAG.getConstant(15, DL, VT));
+  SDValue InvAmt = DAG.getNode(ISD::XOR, DL, VT, Amt,
+                               DAG.getConstant(15, DL, VT));
+  SDValue IsWide = DAG.getNode(ISD::AND, DL, VT, Shamt,
+                               DAG.getConstant(16, DL, VT));
+
+  SDValue ShiftedHi = DAG.getNode(ShiftOpc, DL, VT, Hi, Amt);
+  SDValue ShiftedLo = DAG.getNode(ISD::SRL, DL, VT, Lo, Amt);
+  SDValue Carried = DAG.getNode(ISD::SHL, DL, VT,
+                                DAG.getNode(ISD::SHL, DL, VT, Hi, One), InvAmt);
+  SDValue NarrowLo = DAG.getNode(ISD::OR, DL, VT, ShiftedLo, Carried);
+  SDValue WideHi =
+      IsSRA ? DAG.getNode(ISD::SRA, DL, VT, Hi, DAG.getConstant(15, DL, VT))
+            : Zero;
+
+  SDValue NewLo =
+      DAG.getSelectCC(DL, IsWide, Zero, ShiftedHi, NarrowLo, ISD::SETNE);
+  SDValue NewHi =
+      DAG.getSelectCC(DL, IsWide, Zero, WideHi, ShiftedHi, ISD::SETNE);
+  SDValue Parts[] = {NewLo, NewHi};
+  return DAG.getMergeValues(Parts, DL);
+}
+
 SDValue AAPTargetLowering::LowerVASTART(SDValue Op, SelectionDAG &DAG) const {
   MachineFunction &MF = DAG.getMachineFunction();
   AAPMachineFunctionInfo *MFI = MF.getInfo<AAPMachineFunctionInfo>();
@@ -328,6 +738,27 @@ SDValue AAPTargetLowering::LowerRETURNADDR(SDValue Op,
   return DAG.getCopyFromReg(DAG.getEntryNode(), SDLoc(Op), Reg, MVT::i16);
 }
 
+SDValue AAPTargetLowering::LowerFRAMEADDR(SDValue Op,
+                                          SelectionDAG &DAG) const {
+  MachineFrameInfo &MFI = DAG.getMachineFunction().getFrameInfo();
+  MFI.setFrameAddressIsTaken(true);
+
+  SDLoc DL(Op);
+  unsigned Depth = cast<ConstantSDNode>(Op.getOperand(0))->getZExtValue();
+  SDValue FrameAddr = DAG.getCopyFromReg(
+      DAG.getEntryNode(), DL, AAPRegisterInfo::getFramePtrRegister(),
+      MVT::i16);
+
+  // The frame pointer of the caller is saved just below the frame address
+  while (Depth--) {
+    SDValue Slot = DAG.getNode(ISD::SUB, DL, MVT::i16, FrameAddr,
+                               DAG.getConstant(2, DL, MVT::i16));
+    FrameAddr = DAG.getLoad(MVT::i16, DL, DAG.getEntryNode(), Slot,
+                            MachinePointerInfo());
+  }
+  return FrameAddr;
+}
+
 SDValue AAPTargetLowering::LowerGlobalAddress(SDValue Op,
                                               SelectionDAG &DAG) const {
   const DataLayout DL = DAG.getDataLayout();
@@ -354,10 +785,107 @@ SDValue AAPTargetLowering::LowerBlockAddress(SDValue Op,
   return DAG.getNode(AAPISD::Wrapper, SDLoc(Op), getPointerTy(DL), Result);
 }
 
+SDValue AAPTargetLowering::LowerJumpTable(SDValue Op,
+                                          SelectionDAG &DAG) const {
+  const DataLayout DL = DAG.getDataLayout();
+  JumpTableSDNode *JT = cast<JumpTableSDNode>(Op);
+  SDValue Result = DAG.getTargetJumpTable(JT->getIndex(), getPointerTy(DL));
+  return DAG.getNode(AAPISD::Wrapper, SDLoc(Op), getPointerTy(DL), Result);
+}
+
+bool AAPTargetLowering::isLegalAddressingMode(const DataLayout &DL,
+                                              const AddrMode &AM, Type *Ty,
+                                              unsigned AS,
+                                              Instruction *I) const {
+  // Global addresses must be materialized in a register
+  if (AM.BaseGV)
+    return false;
+
+  if (!AAP::isOff10(AM.BaseOffs))
+    return false;
+
+  // There is no register plus register addressing, however a single
+  // register may be used either as the base or as the scaled register.
+  switch (AM.Scale) {
+  case 0:
+    return true;
+  case 1:
+    return !AM.HasBaseReg;
+  default:
+    return false;
+  }
+}
+
+bool AAPTargetLowering::isLegalAddImmediate(int64_t Imm) const {
+  // Negative immediates are subtracted instead. They are range checked
+  // before being negated, which would overflow for the most negative value.
+  if (Imm < 0)
+    return isInt<11>(Imm) && AAP::isImm10(-Imm);
+  return AAP::isImm10(Imm);
+}
+
+unsigned AAPTargetLowering::getJumpTableEncoding() const {
+  // Code is word addressed, and JMP takes the word address of its
+  // destination in a register. Each entry is therefore a 16-bit code
+  // pointer, emitted and relocated in the same way as any other code
+  // address stored in data.
+  return MachineJumpTableInfo::EK_BlockAddress;
+}
+
 //===----------------------------------------------------------------------===//
 //                      Calling Convention Implementation
 //===----------------------------------------------------------------------===//
 
+static const MCPhysReg ArgRegs[] = {AAP::R2, AAP::R3, AAP::R4,
+                                    AAP::R5, AAP::R6, AAP::R7};
+
+/// CC_AAP_AssignRegGroup - Assign the parts of a split value or aggregate
+/// either entirely to consecutive argument registers, or entirely to the
+/// stack. Parts are held as pending until the last part of the group is seen.
+static bool CC_AAP_AssignRegGroup(unsigned ValNo, MVT ValVT, MVT LocVT,
+                                  CCValAssign::LocInfo LocInfo,
+                                  ISD::ArgFlagsTy ArgFlags, CCState &State) {
+  SmallVectorImpl<CCValAssign> &PendingLocs = State.getPendingLocs();
+
+  // Values which occupy a single register are assigned normally
+  if (!ArgFlags.isSplit() && !ArgFlags.isInConsecutiveRegs() &&
+      PendingLocs.empty())
+    return false;
+
+  PendingLocs.push_back(
+      CCValAssign::getPending(ValNo, ValVT, LocVT, LocInfo));
+
+  bool IsLast = ArgFlags.isInConsecutiveRegs()
+                    ? ArgFlags.isInConsecutiveRegsLast()
+                    : ArgFlags.isSplitEnd();
+  if (!IsLast)
+    return true;
+
+  // Groups of up to four registers are passed in registers if they fit
+  unsigned FirstReg = State.getFirstUnallocated(ArgRegs);
+  unsigned NumRegs = PendingLocs.size();
+  bool InRegs = NumRegs <= 4 && FirstReg + NumRegs <= array_lengthof(ArgRegs);
+
+  for (CCValAssign &VA : PendingLocs) {
+    if (InRegs) {
+      unsigned Reg = State.AllocateReg(ArgRegs);
+      VA.convertToReg(Reg);
+    } else {
+      VA.convertToMem(State.AllocateStack(2, 2));
+    }
+    State.addLoc(VA);
+  }
+  PendingLocs.clear();
+
+  // Later arguments must not be passed in registers once part of the
+  // argument list has been placed on the stack.
+  if (!InRegs) {
+    for (MCPhysReg Reg : ArgRegs)
+      State.AllocateReg(Reg);
+  }
+  return true;
+}
+
 #include "AAPGenCallingConv.inc"
 
 /// For each argument in a function store the number of pieces it is composed
@@ -376,6 +904,23 @@ static void ParseFunctionArgs(const SmallVectorImpl<ArgT> &Args,
   }
 }
 
+CCAssignFn *AAPTargetLowering::CCAssignFnForCall() const {
+  return Subtarget.useABIv2() ? CC_AAP_ABIv2 : CC_AAP;
+}
+
+CCAssignFn *AAPTargetLowering::CCAssignFnForReturn() const { return RetCC_AAP; }
+
+FastISel *
+AAPTargetLowering::createFastISel(FunctionLoweringInfo &FuncInfo,
+                                  const TargetLibraryInfo *LibInfo) const {
+  return AAP::createFastISel(FuncInfo, LibInfo);
+}
+
+bool AAPTargetLowering::functionArgumentNeedsConsecutiveRegisters(
+    Type *Ty, CallingConv::ID CallConv, bool isVarArg) const {
+  return Subtarget.useABIv2() && Ty->isAggregateType();
+}
+
 SDValue AAPTargetLowering::LowerFormalArguments(
     SDValue Chain, CallingConv::ID CallConv, bool isVarArg,
     const SmallVectorImpl<ISD::InputArg> &Ins, const SDLoc &DL,
@@ -431,7 +976,7 @@ SDValue AAPTargetLowering::LowerCCCArguments(
   SmallVector<CCValAssign, 16> ArgLocs;
   CCState CCInfo(CallConv, isVarArg, DAG.getMachineFunction(), ArgLocs,
                  *DAG.getContext());
-  CCInfo.AnalyzeFormalArguments(Ins, CC_AAP);
+  CCInfo.AnalyzeFormalArguments(Ins, CCAssignFnForCall());
 
   // Create frame index for the start of the first vararg value
   if (isVarArg) {
@@ -537,10 +1082,6 @@ AAPTargetLowering::LowerReturn(SDValue Chain, CallingConv::ID CallConv,
   SDValue Flag;
   SmallVector<SDValue, 4> RetOps(1, Chain);
 
-  // Add the link register as the first operand
-  RetOps.push_back(
-      DAG.getRegister(AAPRegisterInfo::getLinkRegister(), MVT::i16));
-
   // Add return registers to the CalleeSaveDisableRegs list.
   MachineRegisterInfo &MRI = DAG.getMachineFunction().getRegInfo();
   for (unsigned i = 0; i != RVLocs.size(); ++i) {
@@ -584,7 +1125,7 @@ SDValue AAPTargetLowering::LowerCCCCallTo(
   CCState CCInfo(CallConv, isVarArg, DAG.getMachineFunction(), ArgLocs,
                  *DAG.getContext());
 
-  CCInfo.AnalyzeCallOperands(Outs, CC_AAP);
+  CCInfo.AnalyzeCallOperands(Outs, CCAssignFnForCall());
 
   // Get a count of how many bytes are to be pushed on the stack.
   unsigned NumBytes = CCInfo.getNextStackOffset();
@@ -770,6 +1311,10 @@ AAPTargetLowering::EmitInstrWithCustomInserter(MachineInstr &MI,
     return emitBrCC(MI, MBB);
   case AAP::SELECT_CC:
     return emitSelectCC(MI, MBB);
+  case AAP::MEMCPY_LOOP:
+  case AAP::MEMMOVE_LOOP:
+  case AAP::MEMSET_LOOP:
+    return emitMemLoop(MI, MBB);
   default:
     llvm_unreachable("Unexpected instruction for custom insertion");
   }
@@ -849,6 +1394,137 @@ AAPTargetLowering::emitSelectCC(MachineInstr &MI,
   return SinkMBB;
 }
 
+// Emit the body of a word loop into LoopMBB. Each iteration stores a word to
+// the destination, which is either the fill word in ValReg or a word loaded
+// from the source. The loop ends when the source, or the destination if
+// there is no source, reaches EndReg.
+static void emitWordLoop(const AAPInstrInfo &TII, MachineRegisterInfo &MRI,
+                         const DebugLoc &DL, MachineBasicBlock *PreMBB,
+                         MachineBasicBlock *LoopMBB,
+                         MachineBasicBlock *ExitMBB, bool Backward,
+                         unsigned DstReg, unsigned SrcReg, unsigned ValReg,
+                         unsigned EndReg) {
+  const TargetRegisterClass *RC = &AAP::GR64RegClass;
+
+  unsigned Dst = MRI.createVirtualRegister(RC);
+  unsigned NextDst = MRI.createVirtualRegister(RC);
+  BuildMI(LoopMBB, DL, TII.get(AAP::PHI), Dst)
+      .addReg(DstReg)
+      .addMBB(PreMBB)
+      .addReg(NextDst)
+      .addMBB(LoopMBB);
+
+  unsigned Cursor = NextDst;
+  if (SrcReg) {
+    unsigned Src = MRI.createVirtualRegister(RC);
+    unsigned NextSrc = MRI.createVirtualRegister(RC);
+    BuildMI(LoopMBB, DL, TII.get(AAP::PHI), Src)
+        .addReg(SrcReg)
+        .addMBB(PreMBB)
+        .addReg(NextSrc)
+        .addMBB(LoopMBB);
+
+    ValReg = MRI.createVirtualRegister(RC);
+    BuildMI(LoopMBB, DL,
+            TII.get(Backward ? AAP::LDW_predec_wb : AAP::LDW_postinc_wb),
+            ValReg)
+        .addReg(NextSrc, RegState::Define)
+        .addReg(Src)
+        .addImm(2);
+    Cursor = NextSrc;
+  }
+
+  BuildMI(LoopMBB, DL,
+          TII.get(Backward ? AAP::STW_predec_wb : AAP::STW_postinc_wb),
+          NextDst)
+      .addReg(Dst)
+      .addImm(2)
+      .addReg(ValReg);
+  BuildMI(LoopMBB, DL, TII.get(AAP::BNE_))
+      .addMBB(LoopMBB)
+      .addReg(Cursor)
+      .addReg(EndReg);
+
+  LoopMBB->addSuccessor(LoopMBB);
+  LoopMBB->addSuccessor(ExitMBB);
+}
+
+MachineBasicBlock *AAPTargetLowering::emitMemLoop(MachineInstr &MI,
+                                                  MachineBasicBlock *MBB) const {
+  const auto &STI = MBB->getParent()->getSubtarget();
+  const auto &TII = *static_cast<const AAPInstrInfo *>(STI.getInstrInfo());
+  DebugLoc DL = MI.getDebugLoc();
+  MachineFunction *MF = MBB->getParent();
+  MachineRegisterInfo &MRI = MF->getRegInfo();
+
+  unsigned Opcode = MI.getOpcode();
+  unsigned DstReg = MI.getOperand(0).getReg();
+  unsigned SrcReg = MI.getOperand(1).getReg();
+  unsigned SizeReg = MI.getOperand(2).getReg();
+
+  // Insert the loops between the entry block and the rest of the block.
+  // Memmove has a second loop which copies backwards, for when the
+  // destination is above the source.
+  const BasicBlock *BB = MBB->getBasicBlock();
+  MachineFunction::iterator It = MBB->getIterator();
+  ++It;
+
+  MachineBasicBlock *EntryMBB = MBB;
+  MachineBasicBlock *LoopMBB = MF->CreateMachineBasicBlock(BB);
+  MachineBasicBlock *BackLoopMBB = nullptr;
+  MachineBasicBlock *SinkMBB = MF->CreateMachineBasicBlock(BB);
+  MF->insert(It, LoopMBB);
+  if (Opcode == AAP::MEMMOVE_LOOP) {
+    BackLoopMBB = MF->CreateMachineBasicBlock(BB);
+    MF->insert(It, BackLoopMBB);
+  }
+  MF->insert(It, SinkMBB);
+
+  // Transfer remainder of entryBB to sinkMBB
+  SinkMBB->splice(SinkMBB->begin(), EntryMBB,
+                  std::next(MachineBasicBlock::iterator(MI)), EntryMBB->end());
+  SinkMBB->transferSuccessorsAndUpdatePHIs(EntryMBB);
+
+  // Find the end of the block which is walked to decide when to stop
+  const TargetRegisterClass *RC = &AAP::GR64RegClass;
+  unsigned EndReg = MRI.createVirtualRegister(RC);
+  BuildMI(EntryMBB, DL, TII.get(AAP::ADD_r), EndReg)
+      .addReg(Opcode == AAP::MEMSET_LOOP ? DstReg : SrcReg)
+      .addReg(SizeReg);
+
+  if (Opcode == AAP::MEMSET_LOOP) {
+    EntryMBB->addSuccessor(LoopMBB);
+    emitWordLoop(TII, MRI, DL, EntryMBB, LoopMBB, SinkMBB, false, DstReg, 0,
+                 SrcReg, EndReg);
+  } else if (Opcode == AAP::MEMCPY_LOOP) {
+    EntryMBB->addSuccessor(LoopMBB);
+    emitWordLoop(TII, MRI, DL, EntryMBB, LoopMBB, SinkMBB, false, DstReg,
+                 SrcReg, 0, EndReg);
+  } else {
+    // Copy backwards from the ends of the blocks to the start of the source
+    // if the destination is above the source
+    unsigned DstEndReg = MRI.createVirtualRegister(RC);
+    BuildMI(EntryMBB, DL, TII.get(AAP::ADD_r), DstEndReg)
+        .addReg(DstReg)
+        .addReg(SizeReg);
+    BuildMI(EntryMBB, DL, TII.get(AAP::BLTU_))
+        .addMBB(BackLoopMBB)
+        .addReg(SrcReg)
+        .addReg(DstReg);
+    EntryMBB->addSuccessor(LoopMBB);
+    EntryMBB->addSuccessor(BackLoopMBB);
+
+    emitWordLoop(TII, MRI, DL, EntryMBB, LoopMBB, SinkMBB, false, DstReg,
+                 SrcReg, 0, EndReg);
+    BuildMI(LoopMBB, DL, TII.get(AAP::BRA)).addMBB(SinkMBB);
+    emitWordLoop(TII, MRI, DL, EntryMBB, BackLoopMBB, SinkMBB, true,
+                 DstEndReg, EndReg, 0, SrcReg);
+  }
+
+  MI.eraseFromParent();
+  return SinkMBB;
+}
+
 //===----------------------------------------------------------------------===//
 //                      AAP Inline Assembly Support
 //===----------------------------------------------------------------------===//
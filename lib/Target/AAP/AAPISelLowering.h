@@ -16,6 +16,7 @@
 #define AAPISELLOWERING_H
 
 #include "AAP.h"
+#include "llvm/CodeGen/CallingConvLower.h"
 #include "llvm/CodeGen/SelectionDAG.h"
 #include "llvm/CodeGen/TargetLowering.h"
 
@@ -25,6 +26,11 @@ namespace llvm {
 class AAPSubtarget;
 class AAPTargetMachine;
 
+namespace AAP {
+FastISel *createFastISel(FunctionLoweringInfo &FuncInfo,
+                         const TargetLibraryInfo *LibInfo);
+} // end namespace AAP
+
 namespace AAPISD {
 enum NodeType {
   // Start the numbering where the builtin ops and target ops leave off.
@@ -46,7 +52,14 @@ enum NodeType {
 
   /// SELECT_CC - Custom selectcc node, where the condition code is an
   /// AAP specific value
-  SELECT_CC
+  SELECT_CC,
+
+  /// MEMCPY, MEMMOVE, MEMSET - Word loops copying or setting a block of
+  /// memory. Operand 0 is the chain, followed by the destination, the source
+  /// or fill word, and the size in bytes, which is a non-zero multiple of 2.
+  MEMCPY,
+  MEMMOVE,
+  MEMSET
 };
 }
 
@@ -69,6 +82,18 @@ public:
   EVT getSetCCResultType(const DataLayout &DL, LLVMContext &Context,
                          EVT VT) const override;
 
+  /// getJumpTableEncoding - Jump table entries are absolute code addresses
+  unsigned getJumpTableEncoding() const override;
+
+  /// isLegalAddressingMode - Memory accesses take a base register and a
+  /// signed 10-bit offset
+  bool isLegalAddressingMode(const DataLayout &DL, const AddrMode &AM,
+                             Type *Ty, unsigned AS,
+                             Instruction *I = nullptr) const override;
+
+  /// isLegalAddImmediate - ADDI and SUBI take an unsigned 10-bit immediate
+  bool isLegalAddImmediate(int64_t Imm) const override;
+
 private:
   const AAPSubtarget &Subtarget;
 
@@ -78,6 +103,19 @@ public:
 
 private:
   SDValue PerformADDCombine(SDNode *N, DAGCombinerInfo &DCE) const;
+  SDValue PerformMULCombine(SDNode *N, DAGCombinerInfo &DCE) const;
+
+//===----------------------- Indexed Addressing -------------------------===//
+public:
+  /// getPreIndexedAddressParts - Form pre-decrement loads and stores
+  bool getPreIndexedAddressParts(SDNode *N, SDValue &Base, SDValue &Offset,
+                                 ISD::MemIndexedMode &AM,
+                                 SelectionDAG &DAG) const override;
+
+  /// getPostIndexedAddressParts - Form post-increment loads and stores
+  bool getPostIndexedAddressParts(SDNode *N, SDNode *Op, SDValue &Base,
+                                  SDValue &Offset, ISD::MemIndexedMode &AM,
+                                  SelectionDAG &DAG) const override;
 
 //===------------------------- Custom Lowering --------------------------===//
 public:
@@ -92,10 +130,15 @@ private:
   SDValue LowerGlobalAddress(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerExternalSymbol(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerBlockAddress(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerJumpTable(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerBR_CC(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerSELECT_CC(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerSELECT_CCBranchless(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerShiftLeftParts(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerShiftRightParts(SDValue Op, SelectionDAG &DAG, bool IsSRA) const;
   SDValue LowerVASTART(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerRETURNADDR(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerFRAMEADDR(SDValue Op, SelectionDAG &DAG) const;
 
 //===---------------- Calling Convention Implementation -----------------===//
 private:
@@ -131,6 +174,23 @@ private:
                           uint32_t *RegMask) const;
 
 public:
+  /// CCAssignFnForCall - The calling convention used for arguments, which
+  /// depends on the ABI of the subtarget
+  CCAssignFn *CCAssignFnForCall() const;
+
+  /// CCAssignFnForReturn - The calling convention used for return values
+  CCAssignFn *CCAssignFnForReturn() const;
+
+  /// createFastISel - Use the AAP fast instruction selector at -O0
+  FastISel *createFastISel(FunctionLoweringInfo &FuncInfo,
+                           const TargetLibraryInfo *LibInfo) const override;
+
+  /// functionArgumentNeedsConsecutiveRegisters - In the revised ABI aggregates
+  /// are passed as a group
+  bool functionArgumentNeedsConsecutiveRegisters(Type *Ty,
+                                                 CallingConv::ID CallConv,
+                                                 bool isVarArg) const override;
+
   bool CanLowerReturn(CallingConv::ID CallConv, MachineFunction &MF,
                       bool isVarArg,
                       const SmallVectorImpl<ISD::OutputArg> &Outs,
@@ -152,6 +212,8 @@ private:
   MachineBasicBlock *emitBrCC(MachineInstr &MI, MachineBasicBlock *MBB) const;
   MachineBasicBlock *emitSelectCC(MachineInstr &MI,
                                   MachineBasicBlock *MBB) const;
+  MachineBasicBlock *emitMemLoop(MachineInstr &MI,
+                                 MachineBasicBlock *MBB) const;
 
 //===------------------- AAP Inline Assembly Support --------------------===//
 public:
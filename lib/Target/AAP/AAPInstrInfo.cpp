@@ -24,10 +24,12 @@
 #include "llvm/CodeGen/MachineMemOperand.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
 #include "llvm/MC/MCContext.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/TargetRegistry.h"
+#include <numeric>
 
 using namespace llvm;
 
@@ -470,3 +472,213 @@ unsigned AAPInstrInfo::getInstSizeInBytes(const MachineInstr &MI) const {
   }
   }
 }
+
+bool AAPInstrInfo::expandPostRAPseudo(MachineInstr &MI) const {
+  unsigned Opcode;
+  switch (MI.getOpcode()) {
+  default:
+    return false;
+  case AAP::LDB_postinc_wb:
+    Opcode = AAP::LDB_postinc;
+    break;
+  case AAP::LDW_postinc_wb:
+    Opcode = AAP::LDW_postinc;
+    break;
+  case AAP::LDB_predec_wb:
+    Opcode = AAP::LDB_predec;
+    break;
+  case AAP::LDW_predec_wb:
+    Opcode = AAP::LDW_predec;
+    break;
+  case AAP::STB_postinc_wb:
+    Opcode = AAP::STB_postinc;
+    break;
+  case AAP::STW_postinc_wb:
+    Opcode = AAP::STW_postinc;
+    break;
+  case AAP::STB_predec_wb:
+    Opcode = AAP::STB_predec;
+    break;
+  case AAP::STW_predec_wb:
+    Opcode = AAP::STW_predec;
+    break;
+  }
+
+  // The writeback register is tied to the base, so it is dropped from the
+  // real instruction. It is kept as an implicit def so that later passes
+  // see that the base register is modified.
+  MachineBasicBlock &MBB = *MI.getParent();
+  MachineInstrBuilder MIB = BuildMI(MBB, MI, MI.getDebugLoc(), get(Opcode));
+  unsigned Base;
+  if (MI.mayLoad()) {
+    Base = MI.getOperand(1).getReg();
+    MIB.add(MI.getOperand(0)).add(MI.getOperand(2)).add(MI.getOperand(3));
+  } else {
+    Base = MI.getOperand(0).getReg();
+    MIB.add(MI.getOperand(1)).add(MI.getOperand(2)).add(MI.getOperand(3));
+  }
+  MIB.addReg(Base, RegState::ImplicitDefine);
+  MIB.setMemRefs(MI.memoperands_begin(), MI.memoperands_end());
+
+  MI.eraseFromParent();
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// MachineOutliner hooks
+//===----------------------------------------------------------------------===//
+
+// Outlined functions are called with BAL, and return with a jump through the
+// link register given to the BAL. R0 can not be used for this, as it holds
+// the return address of the function being outlined from, so each outlined
+// function is given a caller saved register which is free at every call site.
+// The ID of the register is used as both the call and frame construction ID.
+
+bool AAPInstrInfo::isFunctionSafeToOutlineFrom(
+    MachineFunction &MF, bool OutlineFromLinkOnceODRs) const {
+  const Function &F = MF.getFunction();
+
+  // Can F be deduplicated by the linker? If it can, don't outline from it.
+  if (!OutlineFromLinkOnceODRs && F.hasLinkOnceODRLinkage())
+    return false;
+
+  // Don't outline from functions with section markings; the program could
+  // expect that all the code is in the named section.
+  if (F.hasSection())
+    return false;
+
+  return true;
+}
+
+bool AAPInstrInfo::shouldOutlineFromFunctionByDefault(
+    MachineFunction &MF) const {
+  return MF.getFunction().optForMinSize();
+}
+
+// Check whether Reg can be clobbered by a call to the outlined function at
+// the call site C.
+static bool isFreeLinkRegister(unsigned Reg, const outliner::Candidate &C) {
+  const MachineFunction &MF = *C.getMF();
+  if (MF.getRegInfo().isReserved(Reg))
+    return false;
+
+  // The register must not be preserved across calls to the function being
+  // outlined from
+  const MCPhysReg *CSRegs = MF.getRegInfo().getCalleeSavedRegs();
+  for (unsigned i = 0; CSRegs[i]; ++i) {
+    if (CSRegs[i] == Reg)
+      return false;
+  }
+
+  // Nor may it be used by the outlined sequence or live across it
+  return C.LRU.available(Reg) && C.UsedInSequence.available(Reg);
+}
+
+outliner::OutlinedFunction AAPInstrInfo::getOutliningCandidateInfo(
+    std::vector<outliner::Candidate> &RepeatedSequenceLocs) const {
+  outliner::Candidate &FirstCand = RepeatedSequenceLocs[0];
+  unsigned SequenceSize =
+      std::accumulate(FirstCand.front(), std::next(FirstCand.back()), 0,
+                      [this](unsigned Sum, const MachineInstr &MI) {
+                        return Sum + getInstSizeInBytes(MI);
+                      });
+
+  for (outliner::Candidate &C : RepeatedSequenceLocs)
+    C.initLRU(TRI);
+
+  // Pick the link register which is free at the most call sites. Registers in
+  // GR8 are tried first, as the return through them can use the short jump.
+  unsigned LinkReg = 0;
+  unsigned LinkRegUses = 0;
+  for (unsigned Reg : AAP::GR64RegClass) {
+    unsigned Uses = std::count_if(
+        RepeatedSequenceLocs.begin(), RepeatedSequenceLocs.end(),
+        [Reg](const outliner::Candidate &C) {
+          return isFreeLinkRegister(Reg, C);
+        });
+    if (Uses > LinkRegUses) {
+      LinkReg = Reg;
+      LinkRegUses = Uses;
+    }
+    if (Uses == RepeatedSequenceLocs.size())
+      break;
+  }
+
+  // Drop the call sites where the link register is not free
+  RepeatedSequenceLocs.erase(
+      std::remove_if(RepeatedSequenceLocs.begin(), RepeatedSequenceLocs.end(),
+                     [LinkReg](const outliner::Candidate &C) {
+                       return !LinkReg || !isFreeLinkRegister(LinkReg, C);
+                     }),
+      RepeatedSequenceLocs.end());
+  if (RepeatedSequenceLocs.size() < 2)
+    return outliner::OutlinedFunction();
+
+  // A BAL to a symbol is always long, but the return may be short
+  const MCInstrDesc &CallDesc = get(AAP::BAL);
+  const MCInstrDesc &RetDesc = get(AAP::GR8RegClass.contains(LinkReg)
+                                       ? AAP::JMP_short
+                                       : AAP::JMP);
+  for (outliner::Candidate &C : RepeatedSequenceLocs)
+    C.setCallInfo(LinkReg, CallDesc.getSize());
+
+  return outliner::OutlinedFunction(RepeatedSequenceLocs, SequenceSize,
+                                    RetDesc.getSize(), LinkReg);
+}
+
+outliner::InstrType
+AAPInstrInfo::getOutliningType(MachineBasicBlock::iterator &MIT,
+                               unsigned Flags) const {
+  MachineInstr &MI = *MIT;
+
+  if (MI.isDebugInstr() || MI.isKill())
+    return outliner::InstrType::Invisible;
+
+  // Outlined functions are not given a frame, and their link register is
+  // caller saved, so they can not make calls. Branches and returns are not
+  // outlined either, as the outlined function always returns to its caller.
+  if (MI.isCall() || MI.isTerminator() || MI.isReturn())
+    return outliner::InstrType::Illegal;
+
+  // Labels and CFI must stay in the function they were emitted for
+  if (MI.isPosition() || MI.isCFIInstruction())
+    return outliner::InstrType::Illegal;
+
+  // The size of inline assembly is only an estimate
+  if (MI.isInlineAsm())
+    return outliner::InstrType::Illegal;
+
+  // Anything else is safe, including accesses relative to the stack pointer,
+  // since BAL does not adjust it.
+  return outliner::InstrType::Legal;
+}
+
+void AAPInstrInfo::buildOutlinedFrame(
+    MachineBasicBlock &MBB, MachineFunction &MF,
+    const outliner::OutlinedFunction &OF) const {
+  unsigned LinkReg = OF.FrameConstructionID;
+  unsigned Opcode =
+      AAP::GR8RegClass.contains(LinkReg) ? AAP::JMP_short : AAP::JMP;
+
+  // The outliner runs after the short instruction peephole, so the short
+  // form of the return must be chosen here.
+  MBB.addLiveIn(LinkReg);
+  BuildMI(MBB, MBB.end(), DebugLoc(), get(Opcode)).addReg(LinkReg);
+}
+
+MachineBasicBlock::iterator AAPInstrInfo::insertOutlinedCall(
+    Module &M, MachineBasicBlock &MBB, MachineBasicBlock::iterator &It,
+    MachineFunction &MF, const outliner::Candidate &C) const {
+  unsigned LinkReg = C.CallConstructionID;
+
+  // The implicit operands of BAL describe a call through R0, which is not
+  // touched here, so they are replaced by a def of the link register.
+  MachineInstr *Call =
+      MF.CreateMachineInstr(get(AAP::BAL), DebugLoc(), /*NoImp=*/true);
+  MachineInstrBuilder(MF, Call)
+      .addGlobalAddress(M.getNamedValue(MF.getName()))
+      .addReg(LinkReg, RegState::Undef)
+      .addReg(AAP::R1, RegState::Implicit)
+      .addReg(LinkReg, RegState::ImplicitDefine);
+  return MBB.insert(It, Call);
+}
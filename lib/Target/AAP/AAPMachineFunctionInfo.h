@@ -14,6 +14,7 @@
 #ifndef AAPMACHINEFUNCTIONINFO_H
 #define AAPMACHINEFUNCTIONINFO_H
 #include "AAPRegisterInfo.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 
@@ -43,6 +44,11 @@ class AAPMachineFunctionInfo : public MachineFunctionInfo {
   /// VarArgsFrameIndex - FrameIndex for start of varargs area.
   int VarArgsFrameIndex;
 
+  /// ShortRegWeights - Virtual registers used often enough by instructions
+  /// with short forms that they should be allocated to GR8 if possible,
+  /// with the summed frequency of those uses.
+  DenseMap<unsigned, uint64_t> ShortRegWeights;
+
 public:
   AAPMachineFunctionInfo(MachineFunction &MF)
       : MF(MF), CalleeSavedFrameSize(0), SRetReturnReg(0), GlobalBaseReg(0),
@@ -58,6 +64,13 @@ public:
 
   int getVarArgsFrameIndex() const { return VarArgsFrameIndex; }
   void setVarArgsFrameIndex(int Index) { VarArgsFrameIndex = Index; }
+
+  void setShortRegWeight(unsigned Reg, uint64_t Weight) {
+    ShortRegWeights[Reg] = Weight;
+  }
+  uint64_t getShortRegWeight(unsigned Reg) const {
+    return ShortRegWeights.lookup(Reg);
+  }
 };
 
 } // namespace llvm
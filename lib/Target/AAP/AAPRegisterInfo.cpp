@@ -12,27 +12,55 @@
 //===----------------------------------------------------------------------===//
 
 #include "AAPRegisterInfo.h"
+#include "AAPMachineFunctionInfo.h"
 #include "AAPSubtarget.h"
 #include "MCTargetDesc/AAPMCTargetDesc.h"
 #include "llvm/ADT/BitVector.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/Support/CommandLine.h"
 
 using namespace llvm;
 
+static cl::opt<unsigned> ABIv2CalleeSaved(
+    "aap-abi-v2-callee-saved", cl::Hidden, cl::init(8),
+    cl::desc("Number of registers from R8 upwards which are callee-saved "
+             "in the revised ABI"));
+
 #define GET_REGINFO_TARGET_DESC
 #include "AAPGenRegisterInfo.inc"
 #include "llvm/CodeGen/MachineFunction.h"
 
-AAPRegisterInfo::AAPRegisterInfo() : AAPGenRegisterInfo(getLinkRegister()) {}
+AAPRegisterInfo::AAPRegisterInfo() : AAPGenRegisterInfo(getLinkRegister()) {
+  // In the revised ABI the argument and return registers R2-R7 are
+  // caller-saved, and a contiguous block of registers starting at R8 are
+  // callee-saved. The link register is listed so that it is saved by
+  // functions which make calls.
+  unsigned NumSaved = std::min(ABIv2CalleeSaved.getValue(), 56u);
+
+  ABIv2SaveList.push_back(AAP::R0);
+  for (unsigned i = 0; i < NumSaved; ++i)
+    ABIv2SaveList.push_back(AAP::GR64RegClass.getRegister(8 + i));
+  ABIv2SaveList.push_back(0);
+
+  ABIv2RegMask.assign((getNumRegs() + 31) / 32, 0);
+  for (MCPhysReg Reg : ABIv2SaveList) {
+    if (Reg)
+      ABIv2RegMask[Reg / 32] |= 1u << (Reg % 32);
+  }
+}
 
 const MCPhysReg *
 AAPRegisterInfo::getCalleeSavedRegs(const MachineFunction *MF) const {
+  if (MF && MF->getSubtarget<AAPSubtarget>().useABIv2())
+    return ABIv2SaveList.data();
   return CSR_SaveList;
 }
 
 const uint32_t *AAPRegisterInfo::getCallPreservedMask(const MachineFunction &MF,
                                                       CallingConv::ID) const {
+  if (MF.getSubtarget<AAPSubtarget>().useABIv2())
+    return ABIv2RegMask.data();
   return CSR_RegMask;
 }
 
@@ -49,6 +77,27 @@ BitVector AAPRegisterInfo::getReservedRegs(const MachineFunction &MF) const {
   return Reserved;
 }
 
+bool AAPRegisterInfo::getRegAllocationHints(
+    unsigned VirtReg, ArrayRef<MCPhysReg> Order,
+    SmallVectorImpl<MCPhysReg> &Hints, const MachineFunction &MF,
+    const VirtRegMap *VRM, const LiveRegMatrix *Matrix) const {
+  // Copy hints take priority
+  bool BaseImplRetVal = TargetRegisterInfo::getRegAllocationHints(
+      VirtReg, Order, Hints, MF, VRM, Matrix);
+
+  // Registers used often by instructions with short forms prefer GR8. Only
+  // the hottest of the registers which are live at the same time are given
+  // a weight, so that colder registers do not take GR8 from hotter ones.
+  const AAPMachineFunctionInfo *MFI = MF.getInfo<AAPMachineFunctionInfo>();
+  if (MFI->getShortRegWeight(VirtReg)) {
+    for (MCPhysReg Reg : Order) {
+      if (AAP::GR8RegClass.contains(Reg) && !is_contained(Hints, Reg))
+        Hints.push_back(Reg);
+    }
+  }
+  return BaseImplRetVal;
+}
+
 bool AAPRegisterInfo::requiresRegisterScavenging(
     const MachineFunction &MF) const {
   return false;
@@ -121,4 +170,4 @@ unsigned AAPRegisterInfo::getFrameRegister(const MachineFunction &MF) const {
 
 unsigned AAPRegisterInfo::getLinkRegister() { return AAP::R0; }
 unsigned AAPRegisterInfo::getStackPtrRegister() { return AAP::R1; }
-unsigned AAPRegisterInfo::getFramePtrRegister() { return AAP::R2; }
+unsigned AAPRegisterInfo::getFramePtrRegister() { return AAP::R8; }
@@ -15,6 +15,7 @@
 #define AAPREGISTERINFO_H
 
 #include "llvm/CodeGen/TargetRegisterInfo.h"
+#include <vector>
 
 #define GET_REGINFO_HEADER
 #include "AAPGenRegisterInfo.inc"
@@ -24,6 +25,11 @@ namespace llvm {
 class TargetInstrInfo;
 
 struct AAPRegisterInfo : public AAPGenRegisterInfo {
+private:
+  // Callee saved registers and call preserved mask for the revised ABI
+  std::vector<MCPhysReg> ABIv2SaveList;
+  std::vector<uint32_t> ABIv2RegMask;
+
 public:
   AAPRegisterInfo();
 
@@ -35,6 +41,11 @@ public:
 
   BitVector getReservedRegs(const MachineFunction &MF) const override;
 
+  bool getRegAllocationHints(unsigned VirtReg, ArrayRef<MCPhysReg> Order,
+                             SmallVectorImpl<MCPhysReg> &Hints,
+                             const MachineFunction &MF, const VirtRegMap *VRM,
+                             const LiveRegMatrix *Matrix) const override;
+
   bool requiresRegisterScavenging(const MachineFunction &MF) const override;
 
   bool trackLivenessAfterRegAlloc(const MachineFunction &MF) const override;
@@ -13,8 +13,99 @@
 
 #define DEBUG_TYPE "AAP-selectiondag-info"
 #include "AAPTargetMachine.h"
+#include "llvm/CodeGen/SelectionDAG.h"
 using namespace llvm;
 
 AAPSelectionDAGInfo::AAPSelectionDAGInfo() : SelectionDAGTargetInfo() {}
 
 AAPSelectionDAGInfo::~AAPSelectionDAGInfo() {}
+
+// Small copies and fills are expanded to loads and stores by the target
+// independent code, limited by the MaxStoresPer* settings of
+// AAPTargetLowering. Larger ones with a known size reach the hooks below,
+// and are emitted as loops of post-increment or pre-decrement word
+// accesses, which are expanded by the custom inserter.
+
+// Get the number of bytes which can be handled by a word loop, or zero if
+// the size is not known or the memory is not word aligned.
+static uint64_t getWordLoopBytes(SDValue Size, unsigned Align) {
+  ConstantSDNode *ConstSize = dyn_cast<ConstantSDNode>(Size);
+  if (!ConstSize || Align < 2)
+    return 0;
+  uint64_t Bytes = ConstSize->getZExtValue();
+  if (Bytes > 0xffff)
+    return 0;
+  return Bytes & ~uint64_t(1);
+}
+
+SDValue AAPSelectionDAGInfo::EmitTargetCodeForMemcpy(
+    SelectionDAG &DAG, const SDLoc &dl, SDValue Chain, SDValue Dst,
+    SDValue Src, SDValue Size, unsigned Align, bool isVolatile,
+    bool AlwaysInline, MachinePointerInfo DstPtrInfo,
+    MachinePointerInfo SrcPtrInfo) const {
+  uint64_t WordBytes = getWordLoopBytes(Size, Align);
+  if (!WordBytes)
+    return SDValue();
+
+  Chain = DAG.getNode(AAPISD::MEMCPY, dl, MVT::Other, Chain, Dst, Src,
+                      DAG.getConstant(WordBytes, dl, MVT::i16));
+
+  // Copy the odd byte at the end
+  if (cast<ConstantSDNode>(Size)->getZExtValue() != WordBytes) {
+    auto MMOFlags =
+        isVolatile ? MachineMemOperand::MOVolatile : MachineMemOperand::MONone;
+    SDValue Byte = DAG.getExtLoad(
+        ISD::EXTLOAD, dl, MVT::i16, Chain,
+        DAG.getMemBasePlusOffset(Src, WordBytes, dl),
+        SrcPtrInfo.getWithOffset(WordBytes), MVT::i8, 1, MMOFlags);
+    Chain = DAG.getTruncStore(Byte.getValue(1), dl, Byte,
+                              DAG.getMemBasePlusOffset(Dst, WordBytes, dl),
+                              DstPtrInfo.getWithOffset(WordBytes), MVT::i8, 1,
+                              MMOFlags);
+  }
+  return Chain;
+}
+
+SDValue AAPSelectionDAGInfo::EmitTargetCodeForMemmove(
+    SelectionDAG &DAG, const SDLoc &dl, SDValue Chain, SDValue Dst,
+    SDValue Src, SDValue Size, unsigned Align, bool isVolatile,
+    MachinePointerInfo DstPtrInfo, MachinePointerInfo SrcPtrInfo) const {
+  // An odd byte at the end may be overwritten by a backwards copy before it
+  // is read, so only whole words are handled.
+  uint64_t WordBytes = getWordLoopBytes(Size, Align);
+  if (!WordBytes || cast<ConstantSDNode>(Size)->getZExtValue() != WordBytes)
+    return SDValue();
+
+  return DAG.getNode(AAPISD::MEMMOVE, dl, MVT::Other, Chain, Dst, Src,
+                     DAG.getConstant(WordBytes, dl, MVT::i16));
+}
+
+SDValue AAPSelectionDAGInfo::EmitTargetCodeForMemset(
+    SelectionDAG &DAG, const SDLoc &dl, SDValue Chain, SDValue Dst,
+    SDValue Src, SDValue Size, unsigned Align, bool isVolatile,
+    MachinePointerInfo DstPtrInfo) const {
+  uint64_t WordBytes = getWordLoopBytes(Size, Align);
+  if (!WordBytes)
+    return SDValue();
+
+  // Replicate the fill byte into both halves of a word
+  SDValue Byte = DAG.getZExtOrTrunc(Src, dl, MVT::i16);
+  Byte = DAG.getNode(ISD::AND, dl, MVT::i16, Byte,
+                     DAG.getConstant(0xff, dl, MVT::i16));
+  SDValue Word = DAG.getNode(
+      ISD::OR, dl, MVT::i16, Byte,
+      DAG.getNode(ISD::SHL, dl, MVT::i16, Byte,
+                  DAG.getConstant(8, dl, MVT::i16)));
+
+  Chain = DAG.getNode(AAPISD::MEMSET, dl, MVT::Other, Chain, Dst, Word,
+                      DAG.getConstant(WordBytes, dl, MVT::i16));
+
+  // Set the odd byte at the end
+  if (cast<ConstantSDNode>(Size)->getZExtValue() != WordBytes)
+    Chain = DAG.getTruncStore(
+        Chain, dl, Byte, DAG.getMemBasePlusOffset(Dst, WordBytes, dl),
+        DstPtrInfo.getWithOffset(WordBytes), MVT::i8, 1,
+        isVolatile ? MachineMemOperand::MOVolatile
+                   : MachineMemOperand::MONone);
+  return Chain;
+}
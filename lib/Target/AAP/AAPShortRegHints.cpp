@@ -0,0 +1,185 @@
+//===-- AAPShortRegHints.cpp - Hint registers with short encodings --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Pass to find the virtual registers which should be allocated to GR8, so
+// that the instructions using them can be replaced by their short forms in
+// AAPShortInstrPeephole. Each use or definition by an instruction with a
+// short form is weighted by the frequency of its block. Registers are then
+// considered from the hottest down, and a register is only hinted while
+// fewer hotter hinted registers than there are in GR8 are live at the same
+// time, so that registers used in hot code are preferred.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "aap-short-reg-hints"
+
+#include "AAP.h"
+#include "AAPMachineFunctionInfo.h"
+#include "MCTargetDesc/AAPMCTargetDesc.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/LiveIntervals.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+
+using namespace llvm;
+
+// Under the default ABI GR8 is callee saved, so a hinted register may need a
+// save and a restore on entry. By default a register must be used by short
+// forms more often than that before it is hinted.
+static cl::opt<unsigned> HintThreshold(
+    "aap-short-reg-hint-threshold", cl::Hidden, cl::init(200),
+    cl::desc("Weight, as a percentage of the function entry frequency, above "
+             "which a register is hinted to a short encoding register"));
+
+namespace {
+struct ShortRegHints : public MachineFunctionPass {
+  static char ID;
+  ShortRegHints() : MachineFunctionPass(ID) {}
+
+  StringRef getPassName() const override {
+    return "AAP Short Encoding Register Hints";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<MachineBlockFrequencyInfo>();
+    AU.addRequired<LiveIntervals>();
+    AU.setPreservesAll();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  bool runOnMachineFunction(MachineFunction &MF) override;
+};
+
+char ShortRegHints::ID = 0;
+} // end of anonymous namespace
+
+FunctionPass *llvm::createAAPShortRegHintsPass() { return new ShortRegHints(); }
+
+// Whether an instruction has a short form which may be used if all of its
+// registers are in GR8. This mirrors the immediate checks made by
+// AAPShortInstrPeephole.
+static bool hasShortForm(const MachineInstr &MI) {
+  auto isImmOperand = [&MI](unsigned OpNo, bool (*Pred)(int64_t)) {
+    const MachineOperand &MO = MI.getOperand(OpNo);
+    return MO.isImm() && Pred(MO.getImm());
+  };
+
+  switch (MI.getOpcode()) {
+  default:
+    return false;
+  case AAP::MOV_r:
+  case AAP::ADD_r:
+  case AAP::AND_r:
+  case AAP::OR_r:
+  case AAP::XOR_r:
+  case AAP::SUB_r:
+  case AAP::ASR_r:
+  case AAP::LSL_r:
+  case AAP::LSR_r:
+  case AAP::JMP:
+  case AAP::JAL:
+    return true;
+  case AAP::MOVI_i16:
+    return isImmOperand(1, AAP::isImm6);
+  case AAP::ADDI_i10:
+  case AAP::SUBI_i10:
+    return isImmOperand(2, AAP::isImm3);
+  case AAP::ASRI_i6:
+  case AAP::LSLI_i6:
+  case AAP::LSRI_i6:
+    return isImmOperand(2, AAP::isShiftImm3);
+  case AAP::LDB:
+  case AAP::LDW:
+    return isImmOperand(2, AAP::isOff3);
+  case AAP::STB:
+  case AAP::STW:
+    return isImmOperand(1, AAP::isOff3);
+  case AAP::LDB_postinc_wb:
+  case AAP::LDW_postinc_wb:
+  case AAP::LDB_predec_wb:
+  case AAP::LDW_predec_wb:
+    return isImmOperand(3, AAP::isOff3);
+  case AAP::STB_postinc_wb:
+  case AAP::STW_postinc_wb:
+  case AAP::STB_predec_wb:
+  case AAP::STW_predec_wb:
+    return isImmOperand(2, AAP::isOff3);
+  }
+}
+
+bool ShortRegHints::runOnMachineFunction(MachineFunction &MF) {
+  const MachineBlockFrequencyInfo &MBFI =
+      getAnalysis<MachineBlockFrequencyInfo>();
+  const MachineRegisterInfo &MRI = MF.getRegInfo();
+  AAPMachineFunctionInfo *MFI = MF.getInfo<AAPMachineFunctionInfo>();
+
+  // Sum the frequencies of the instructions with short forms which use each
+  // virtual register.
+  DenseMap<unsigned, uint64_t> Weights;
+  for (const MachineBasicBlock &MBB : MF) {
+    uint64_t Freq = MBFI.getBlockFreq(&MBB).getFrequency();
+    for (const MachineInstr &MI : MBB) {
+      if (!hasShortForm(MI))
+        continue;
+      for (const MachineOperand &MO : MI.operands()) {
+        if (MO.isReg() && TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+          Weights[MO.getReg()] += Freq;
+      }
+    }
+  }
+
+  uint64_t Threshold = MBFI.getEntryFreq() * HintThreshold / 100;
+  SmallVector<std::pair<uint64_t, unsigned>, 16> Candidates;
+  for (const auto &Entry : Weights) {
+    if (Entry.second > Threshold &&
+        MRI.getRegClass(Entry.first) == &AAP::GR64RegClass)
+      Candidates.push_back({Entry.second, Entry.first});
+  }
+
+  // Consider the hottest registers first, breaking ties by register number
+  // so that the result does not depend on the map's iteration order.
+  llvm::sort(Candidates.begin(), Candidates.end(),
+             [](const std::pair<uint64_t, unsigned> &A,
+                const std::pair<uint64_t, unsigned> &B) {
+               return A.first > B.first ||
+                      (A.first == B.first && A.second < B.second);
+             });
+
+  unsigned NumShortRegs = count_if(AAP::GR8RegClass, [&MRI](MCPhysReg Reg) {
+    return MRI.isAllocatable(Reg);
+  });
+
+  LiveIntervals &LIS = getAnalysis<LiveIntervals>();
+  SmallVector<unsigned, 16> Hinted;
+  for (const auto &Candidate : Candidates) {
+    unsigned Reg = Candidate.second;
+    const LiveInterval &LI = LIS.getInterval(Reg);
+    unsigned NumHotter = count_if(Hinted, [&LIS, &LI](unsigned HintedReg) {
+      return LIS.getInterval(HintedReg).overlaps(LI);
+    });
+    if (NumHotter >= NumShortRegs) {
+      LLVM_DEBUG(dbgs() << "Not hinting " << printReg(Reg)
+                        << ", GR8 is taken by hotter registers\n");
+      continue;
+    }
+    LLVM_DEBUG(dbgs() << "Hinting " << printReg(Reg)
+                      << " to a short encoding register, weight "
+                      << Candidate.first << "\n");
+    MFI->setShortRegWeight(Reg, Candidate.first);
+    Hinted.push_back(Reg);
+  }
+  return false;
+}
@@ -13,6 +13,7 @@
 
 #include "AAPSubtarget.h"
 #include "AAP.h"
+#include "MCTargetDesc/AAPMCTargetDesc.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Support/TargetRegistry.h"
 
@@ -28,5 +29,12 @@ void AAPSubtarget::anchor() {}
 
 AAPSubtarget::AAPSubtarget(const Triple &TT, const std::string &CPU,
                            const std::string &FS, const TargetMachine &TM)
-    : AAPGenSubtargetInfo(TT, CPU, FS), InstrInfo(*this), FrameLowering(),
+    : AAPGenSubtargetInfo(TT, CPU, FS),
+      InstrInfo(initializeSubtargetDependencies(CPU, FS)), FrameLowering(),
       TLInfo(TM, *this), TSInfo() {}
+
+AAPSubtarget &AAPSubtarget::initializeSubtargetDependencies(StringRef CPU,
+                                                            StringRef FS) {
+  ParseSubtargetFeatures(CPU, FS);
+  return *this;
+}
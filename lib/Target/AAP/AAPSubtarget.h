@@ -32,6 +32,11 @@ class StringRef;
 
 class AAPSubtarget : public AAPGenSubtargetInfo {
   virtual void anchor();
+
+  // Subtarget features, set by ParseSubtargetFeatures
+  bool HasMulDiv = false;
+  bool UseABIv2 = false;
+
   AAPInstrInfo InstrInfo;
   AAPFrameLowering FrameLowering;
   AAPTargetLowering TLInfo;
@@ -48,6 +53,13 @@ public:
   /// subtarget options.  Definition of function is auto generated by tblgen.
   void ParseSubtargetFeatures(StringRef CPU, StringRef FS);
 
+  /// initializeSubtargetDependencies - Parse the features before the members
+  /// which depend on them are constructed.
+  AAPSubtarget &initializeSubtargetDependencies(StringRef CPU, StringRef FS);
+
+  bool hasMulDiv() const { return HasMulDiv; }
+  bool useABIv2() const { return UseABIv2; }
+
   const AAPInstrInfo *getInstrInfo() const override { return &InstrInfo; }
   const AAPFrameLowering *getFrameLowering() const override {
     return &FrameLowering;
@@ -61,6 +73,8 @@ public:
   const TargetRegisterInfo *getRegisterInfo() const override {
     return &InstrInfo.getRegisterInfo();
   }
+
+  bool enableMachineScheduler() const override { return true; }
 };
 } // namespace llvm
 
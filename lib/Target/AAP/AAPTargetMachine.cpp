@@ -12,8 +12,10 @@
 //===----------------------------------------------------------------------===//
 
 #include "AAPTargetMachine.h"
+#include "AAPTargetTransformInfo.h"
 #include "MCTargetDesc/AAPMCTargetDesc.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/CodeGen/Passes.h"
 #include "llvm/CodeGen/TargetLoweringObjectFileImpl.h"
 #include "llvm/CodeGen/TargetPassConfig.h"
@@ -49,6 +51,10 @@ AAPTargetMachine::AAPTargetMachine(const Target &T, const Triple &TT,
       TLOF(make_unique<TargetLoweringObjectFileELF>()),
       Subtarget(TT, CPU, FS, *this) {
   initAsmInfo();
+
+  // Outline repeated sequences from functions optimized for minimum size
+  setMachineOutliner(true);
+  setSupportsDefaultOutlining(true);
 }
 
 AAPTargetMachine::~AAPTargetMachine() {}
@@ -65,6 +71,7 @@ public:
   }
 
   bool addInstSelector() override;
+  void addOptimizedRegAlloc(FunctionPass *RegAllocPass) override;
   void addPreEmitPass() override;
 };
 } // namespace
@@ -73,11 +80,23 @@ TargetPassConfig *AAPTargetMachine::createPassConfig(PassManagerBase &PM) {
   return new AAPPassConfig(*this, PM);
 }
 
+TargetTransformInfo
+AAPTargetMachine::getTargetTransformInfo(const Function &F) {
+  return TargetTransformInfo(AAPTTIImpl(this, F));
+}
+
 bool AAPPassConfig::addInstSelector() {
   addPass(createAAPISelDag(getAAPTargetMachine(), getOptLevel()));
   return false;
 }
 
+void AAPPassConfig::addOptimizedRegAlloc(FunctionPass *RegAllocPass) {
+  // The short encoding register hints need live intervals, so they are
+  // computed after scheduling, just before allocation
+  insertPass(&MachineSchedulerID, createAAPShortRegHintsPass());
+  TargetPassConfig::addOptimizedRegAlloc(RegAllocPass);
+}
+
 void AAPPassConfig::addPreEmitPass() {
   addPass(&BranchRelaxationPassID);
   addPass(createAAPShortInstrPeepholePass(getAAPTargetMachine()), false);
@@ -0,0 +1,195 @@
+//===-- AAPTargetTransformInfo.h - AAP specific TTI -------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file a TargetTransformInfo::Concept conforming object specific to the
+// AAP target machine. It describes the costs of a 16-bit machine with no
+// hardware multiply or divide by default, so that the target independent
+// optimizers make sensible decisions for code size.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_AAP_AAPTARGETTRANSFORMINFO_H
+#define LLVM_LIB_TARGET_AAP_AAPTARGETTRANSFORMINFO_H
+
+#include "AAP.h"
+#include "AAPSubtarget.h"
+#include "AAPTargetMachine.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/CodeGen/BasicTTIImpl.h"
+#include "llvm/CodeGen/TargetLowering.h"
+#include "llvm/Support/MathExtras.h"
+
+namespace llvm {
+class AAPTTIImpl : public BasicTTIImplBase<AAPTTIImpl> {
+  typedef BasicTTIImplBase<AAPTTIImpl> BaseT;
+  typedef TargetTransformInfo TTI;
+  friend BaseT;
+
+  const AAPSubtarget *ST;
+  const AAPTargetLowering *TLI;
+
+  const AAPSubtarget *getST() const { return ST; }
+  const AAPTargetLowering *getTLI() const { return TLI; }
+
+  // Approximate costs of the runtime library multiply and divide routines,
+  // including the call sequence
+  static const unsigned MulLibcallCost = 16;
+  static const unsigned DivLibcallCost = 40;
+
+public:
+  explicit AAPTTIImpl(const AAPTargetMachine *TM, const Function &F)
+      : BaseT(TM, F.getParent()->getDataLayout()), ST(TM->getSubtargetImpl(F)),
+        TLI(ST->getTargetLowering()) {}
+
+  TTI::PopcntSupportKind getPopcntSupport(unsigned TyWidth) {
+    return TTI::PSK_Software;
+  }
+
+  // The link, stack and frame pointer registers are not available
+  unsigned getNumberOfRegisters(bool Vector) {
+    return Vector ? 0 : AAP::GR64RegClass.getNumRegs() - 3;
+  }
+
+  unsigned getRegisterBitWidth(bool Vector) const { return Vector ? 0 : 16; }
+
+  // Loads and stores can post-increment their base register for free
+  bool shouldFavorPostInc() const { return true; }
+
+  // Immediates which fit the short move are cheapest, and wider immediates
+  // are materialized a word at a time
+  int getIntImmCost(const APInt &Imm, Type *Ty) {
+    assert(Ty->isIntegerTy());
+    unsigned BitSize = Ty->getPrimitiveSizeInBits();
+    if (BitSize == 0)
+      return ~0U;
+
+    if (BitSize <= 16) {
+      if (AAP::isImm6(Imm.getZExtValue()))
+        return TTI::TCC_Basic;
+      return 2 * TTI::TCC_Basic;
+    }
+
+    int Cost = 0;
+    for (unsigned Lo = 0; Lo < BitSize; Lo += 16) {
+      APInt Part = Imm.extractBits(std::min(16u, BitSize - Lo), Lo);
+      Cost += AAP::isImm6(Part.getZExtValue()) ? TTI::TCC_Basic
+                                               : 2 * TTI::TCC_Basic;
+    }
+    return Cost;
+  }
+
+  int getIntImmCost(unsigned Opc, unsigned Idx, const APInt &Imm, Type *Ty) {
+    assert(Ty->isIntegerTy());
+    if (Ty->getPrimitiveSizeInBits() <= 16) {
+      int64_t Val = Imm.getSExtValue();
+      switch (Opc) {
+      default:
+        break;
+      case Instruction::GetElementPtr:
+        if (Idx == 0)
+          return TTI::TCC_Free;
+        break;
+      case Instruction::Add:
+      case Instruction::Sub:
+        // Folded into ADDI or SUBI
+        if (Idx == 1 && AAP::isImm10(Val < 0 ? -Val : Val))
+          return TTI::TCC_Free;
+        break;
+      case Instruction::And:
+      case Instruction::Or:
+      case Instruction::Xor:
+        if (Idx == 1 && AAP::isImm9(Imm.getZExtValue()))
+          return TTI::TCC_Free;
+        break;
+      case Instruction::Shl:
+      case Instruction::LShr:
+      case Instruction::AShr:
+        if (Idx == 1)
+          return TTI::TCC_Free;
+        break;
+      }
+    }
+    return getIntImmCost(Imm, Ty);
+  }
+
+  int getIntImmCost(Intrinsic::ID IID, unsigned Idx, const APInt &Imm,
+                    Type *Ty) {
+    return getIntImmCost(Imm, Ty);
+  }
+
+  unsigned getArithmeticInstrCost(
+      unsigned Opcode, Type *Ty,
+      TTI::OperandValueKind Opd1Info = TTI::OK_AnyValue,
+      TTI::OperandValueKind Opd2Info = TTI::OK_AnyValue,
+      TTI::OperandValueProperties Opd1PropInfo = TTI::OP_None,
+      TTI::OperandValueProperties Opd2PropInfo = TTI::OP_None,
+      ArrayRef<const Value *> Args = ArrayRef<const Value *>()) {
+    int ISD = TLI->InstructionOpcodeToISD(Opcode);
+    std::pair<unsigned, MVT> LT = TLI->getTypeLegalizationCost(DL, Ty);
+
+    bool IsConstant = Opd2Info == TTI::OK_UniformConstantValue;
+    bool IsPow2 = IsConstant && Opd2PropInfo == TTI::OP_PowerOf2;
+    bool IsWide = LT.first > 1;
+
+    switch (ISD) {
+    default:
+      break;
+    case ISD::ADD:
+    case ISD::SUB:
+      // Each word after the first also propagates a carry
+      if (IsWide)
+        return 2 * LT.first - 1;
+      break;
+    case ISD::SHL:
+    case ISD::SRL:
+    case ISD::SRA:
+      // Wide shifts by a constant combine two shifts per word, and wide
+      // shifts by a variable amount need a branch on the amount
+      if (IsWide)
+        return (IsConstant ? 3 : 8) * LT.first;
+      break;
+    case ISD::MUL:
+      if (IsPow2)
+        return LT.first;
+      if (!IsWide && ST->hasMulDiv())
+        return 2;
+      // Constant multiplies are expanded to shifts and adds
+      if (!IsWide && IsConstant)
+        return 4;
+      return MulLibcallCost * LT.first;
+    case ISD::SDIV:
+    case ISD::UDIV:
+    case ISD::SREM:
+    case ISD::UREM:
+      if (IsPow2 && !IsWide)
+        return ISD == ISD::UDIV || ISD == ISD::UREM ? 1 : 4;
+      if (!IsWide && ST->hasMulDiv())
+        return 16;
+      return DivLibcallCost * LT.first;
+    }
+    return BaseT::getArithmeticInstrCost(Opcode, Ty, Opd1Info, Opd2Info,
+                                         Opd1PropInfo, Opd2PropInfo, Args);
+  }
+
+  // Only fully unroll small loops, since runtime and partial unrolling
+  // increase code size.
+  void getUnrollingPreferences(Loop *L, ScalarEvolution &SE,
+                               TTI::UnrollingPreferences &UP) {
+    UP.Threshold = 40;
+    UP.PartialThreshold = 0;
+    UP.OptSizeThreshold = 0;
+    UP.PartialOptSizeThreshold = 0;
+    UP.Partial = false;
+    UP.Runtime = false;
+  }
+};
+
+} // end namespace llvm
+
+#endif // LLVM_LIB_TARGET_AAP_AAPTARGETTRANSFORMINFO_H
@@ -15,6 +15,7 @@
 #include "AAPMCAsmInfo.h"
 #include "InstPrinter/AAPInstPrinter.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/MC/MCInstrAnalysis.h"
 #include "llvm/MC/MCInstrInfo.h"
 #include "llvm/MC/MCRegisterInfo.h"
 #include "llvm/MC/MCSubtargetInfo.h"
@@ -48,6 +49,10 @@ static MCSubtargetInfo *createAAPMCSubtargetInfo(const Triple &TT,
   return createAAPMCSubtargetInfoImpl(TT, CPU, FS);
 }
 
+static MCInstrAnalysis *createAAPMCInstrAnalysis(const MCInstrInfo *Info) {
+  return new MCInstrAnalysis(Info);
+}
+
 static MCInstPrinter *createAAPMCInstPrinter(const Triple &T,
                                              unsigned SyntaxVariant,
                                              const MCAsmInfo &MAI,
@@ -74,6 +79,9 @@ extern "C" void LLVMInitializeAAPTargetMC() {
   // Register the MC subtarget info.
   TargetRegistry::RegisterMCSubtargetInfo(getTheAAPTarget(),
                                           createAAPMCSubtargetInfo);
+  // Register the MC instruction analyzer.
+  TargetRegistry::RegisterMCInstrAnalysis(getTheAAPTarget(),
+                                          createAAPMCInstrAnalysis);
   // Register the MCInstPrinter.
   TargetRegistry::RegisterMCInstPrinter(getTheAAPTarget(),
                                         createAAPMCInstPrinter);
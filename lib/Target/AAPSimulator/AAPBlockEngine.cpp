@@ -0,0 +1,643 @@
+//===-- AAPBlockEngine.cpp - AAP Simulator Block Translation Engine -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides the implementation of the block translation engine.
+//
+// Straight-line code is translated, up to and including the next branch or
+// jump, into a block of micro-ops whose operands have been resolved to
+// register file indices and sign extended immediates. Micro-ops are executed
+// with threaded dispatch (computed goto where the host compiler supports it)
+// and each block remembers its successors so that execution chains from one
+// block to the next without returning to the main loop.
+//
+// Instructions which are rare or have side effects beyond the processor
+// state (such as NOP, which handles I/O and exits) are executed through the
+// reference interpreter, AAPSimulator::exec. Everything else uses the fast
+// AAPSimState accessors, so the engine must not be used while an observer
+// is attached to the state.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/Compiler.h"
+#include "AAPBlockEngine.h"
+#include "AAPSimulator.h"
+
+#define GET_INSTRINFO_ENUM
+#include "AAPGenInstrInfo.inc"
+
+using namespace llvm;
+using namespace AAPSim;
+
+#if defined(__GNUC__)
+#define AAP_THREADED_DISPATCH 1
+#else
+#define AAP_THREADED_DISPATCH 0
+#endif
+
+// Maximum number of instructions in a single translated block
+static const unsigned MaxBlockInsts = 256;
+
+// All micro-op kinds. Kinds after FIRST_TERMINATOR end a block.
+#define AAP_MICRO_OPS(X)                                                       \
+  X(MOV) X(MOVI)                                                               \
+  X(ADD) X(ADDC) X(ADDI) X(SUB) X(SUBC) X(SUBI)                                \
+  X(AND) X(ANDI) X(OR) X(ORI) X(XOR) X(XORI)                                   \
+  X(ASR) X(ASRI) X(LSL) X(LSLI) X(LSR) X(LSRI)                                 \
+  X(LDB) X(LDW) X(LDB_POSTINC) X(LDW_POSTINC) X(LDB_PREDEC) X(LDW_PREDEC)      \
+  X(STB) X(STW) X(STB_POSTINC) X(STW_POSTINC) X(STB_PREDEC) X(STW_PREDEC)      \
+  X(EXEC)                                                                      \
+  X(FIRST_TERMINATOR)                                                          \
+  X(BAL) X(JAL) X(JMP) X(BRA)                                                  \
+  X(BEQ) X(BNE) X(BLTS) X(BLES) X(BLTU) X(BLEU)                                \
+  X(GOTO)
+
+namespace {
+enum MicroOpKind {
+#define AAP_MICRO_OP_ENUM(Name) UOP_##Name,
+  AAP_MICRO_OPS(AAP_MICRO_OP_ENUM)
+#undef AAP_MICRO_OP_ENUM
+  NUM_MICRO_OPS
+};
+} // end anonymous namespace
+
+// Map an opcode onto the micro-op which implements it
+static MicroOpKind getMicroOpKind(unsigned Opcode) {
+  switch (Opcode) {
+  default:                     return UOP_EXEC;
+  case AAP::MOV_r:
+  case AAP::MOV_r_short:       return UOP_MOV;
+  case AAP::MOVI_i16:
+  case AAP::MOVI_i6_short:     return UOP_MOVI;
+  case AAP::ADD_r:
+  case AAP::ADD_r_short:       return UOP_ADD;
+  case AAP::ADDC_r:            return UOP_ADDC;
+  case AAP::ADDI_i10:
+  case AAP::ADDI_i3_short:     return UOP_ADDI;
+  case AAP::SUB_r:
+  case AAP::SUB_r_short:       return UOP_SUB;
+  case AAP::SUBC_r:            return UOP_SUBC;
+  case AAP::SUBI_i10:
+  case AAP::SUBI_i3_short:     return UOP_SUBI;
+  case AAP::AND_r:
+  case AAP::AND_r_short:       return UOP_AND;
+  case AAP::ANDI_i9:           return UOP_ANDI;
+  case AAP::OR_r:
+  case AAP::OR_r_short:        return UOP_OR;
+  case AAP::ORI_i9:            return UOP_ORI;
+  case AAP::XOR_r:
+  case AAP::XOR_r_short:       return UOP_XOR;
+  case AAP::XORI_i9:           return UOP_XORI;
+  case AAP::ASR_r:
+  case AAP::ASR_r_short:       return UOP_ASR;
+  case AAP::ASRI_i6:
+  case AAP::ASRI_i3_short:     return UOP_ASRI;
+  case AAP::LSL_r:
+  case AAP::LSL_r_short:       return UOP_LSL;
+  case AAP::LSLI_i6:
+  case AAP::LSLI_i3_short:     return UOP_LSLI;
+  case AAP::LSR_r:
+  case AAP::LSR_r_short:       return UOP_LSR;
+  case AAP::LSRI_i6:
+  case AAP::LSRI_i3_short:     return UOP_LSRI;
+  case AAP::LDB:
+  case AAP::LDB_short:         return UOP_LDB;
+  case AAP::LDW:
+  case AAP::LDW_short:         return UOP_LDW;
+  case AAP::LDB_postinc:
+  case AAP::LDB_postinc_short: return UOP_LDB_POSTINC;
+  case AAP::LDW_postinc:
+  case AAP::LDW_postinc_short: return UOP_LDW_POSTINC;
+  case AAP::LDB_predec:
+  case AAP::LDB_predec_short:  return UOP_LDB_PREDEC;
+  case AAP::LDW_predec:
+  case AAP::LDW_predec_short:  return UOP_LDW_PREDEC;
+  case AAP::STB:
+  case AAP::STB_short:         return UOP_STB;
+  case AAP::STW:
+  case AAP::STW_short:         return UOP_STW;
+  case AAP::STB_postinc:
+  case AAP::STB_postinc_short: return UOP_STB_POSTINC;
+  case AAP::STW_postinc:
+  case AAP::STW_postinc_short: return UOP_STW_POSTINC;
+  case AAP::STB_predec:
+  case AAP::STB_predec_short:  return UOP_STB_PREDEC;
+  case AAP::STW_predec:
+  case AAP::STW_predec_short:  return UOP_STW_PREDEC;
+  case AAP::BAL:
+  case AAP::BAL_short:         return UOP_BAL;
+  case AAP::JAL:
+  case AAP::JAL_short:         return UOP_JAL;
+  case AAP::JMP:
+  case AAP::JMP_short:         return UOP_JMP;
+  case AAP::BRA:
+  case AAP::BRA_short:         return UOP_BRA;
+  case AAP::BEQ_:
+  case AAP::BEQ_short:         return UOP_BEQ;
+  case AAP::BNE_:
+  case AAP::BNE_short:         return UOP_BNE;
+  case AAP::BLTS_:
+  case AAP::BLTS_short:        return UOP_BLTS;
+  case AAP::BLES_:
+  case AAP::BLES_short:        return UOP_BLES;
+  case AAP::BLTU_:
+  case AAP::BLTU_short:        return UOP_BLTU;
+  case AAP::BLEU_:
+  case AAP::BLEU_short:        return UOP_BLEU;
+  }
+}
+
+// Whether an opcode is handled by the reference interpreter
+static bool isKnownOpcode(unsigned Opcode) {
+  switch (Opcode) {
+  case AAP::NOP:
+  case AAP::NOP_short:
+  case AAP::MUL_r:
+  case AAP::MULHS_r:
+  case AAP::MULHU_r:
+  case AAP::DIVS_r:
+  case AAP::DIVU_r:
+  case AAP::REMS_r:
+  case AAP::REMU_r:
+    return true;
+  default:
+    return getMicroOpKind(Opcode) != UOP_EXEC;
+  }
+}
+
+AAPBlockEngine::AAPBlockEngine(AAPSimulator &Sim, AAPSimState &State,
+                               const AAPDecodeCache &DecodeCache,
+                               AAPSimStats &Stats)
+    : Sim(Sim), State(State), DecodeCache(DecodeCache), Stats(Stats),
+      Generation(DecodeCache.getGeneration()), DispatchTable(nullptr) {}
+
+void AAPBlockEngine::collectStats() {
+  for (auto &Entry : Blocks) {
+    AAPBlock &B = *Entry.second;
+    uint64_t Count = B.ExitCount[0] + B.ExitCount[1];
+    if (!Count)
+      continue;
+    for (const AAPMicroOp &Op : B.Ops)
+      if (Op.Inst)
+        Stats.addInst(*Op.Inst, Op.PC, Count);
+
+    // Conditional branches leave through slot 1 when taken
+    const AAPMicroOp &Last = B.Ops.back();
+    if (Last.Inst) {
+      switch (AAPSimStats::getBranchKind(Last.Inst->Opcode)) {
+      case AAPSimStats::NotBranch:
+        break;
+      case AAPSimStats::CondBranch:
+        Stats.addBranches(B.ExitCount[1], B.ExitCount[0]);
+        break;
+      case AAPSimStats::UncondBranch:
+        Stats.addBranches(Count, 0);
+        break;
+      }
+
+      // Direct calls always reach the same target. Indirect calls are
+      // counted as they execute.
+      if (Last.Kind == UOP_BAL)
+        Stats.addCall(Last.PC, Last.PC + Last.Imm, Count);
+    }
+    B.ExitCount[0] = B.ExitCount[1] = 0;
+  }
+}
+
+void AAPBlockEngine::countPartialBlock(const AAPBlock &B,
+                                       const AAPMicroOp *Last) {
+  for (const AAPMicroOp *Op = B.Ops.data(); Op <= Last; ++Op)
+    if (Op->Inst)
+      Stats.addInst(*Op->Inst, Op->PC);
+}
+
+void AAPBlockEngine::flush() {
+  collectStats();
+  Blocks.clear();
+  Generation = DecodeCache.getGeneration();
+}
+
+AAPBlock *AAPBlockEngine::getBlock(uint32_t pc_w) {
+  auto It = Blocks.find(pc_w);
+  if (It != Blocks.end())
+    return It->second.get();
+  return translate(pc_w);
+}
+
+AAPBlock *AAPBlockEngine::translate(uint32_t pc_w) {
+  std::unique_ptr<AAPBlock> B(new AAPBlock());
+  B->NumInsts = 0;
+  B->Succ[0] = B->Succ[1] = nullptr;
+  B->SuccPC[0] = B->SuccPC[1] = ~0u;
+  B->ExitCount[0] = B->ExitCount[1] = 0;
+
+  uint32_t PC = pc_w;
+  while (true) {
+    const AAPDecodedInst *Inst = nullptr;
+    if (B->NumInsts < MaxBlockInsts)
+      Inst = Sim.decode(PC);
+
+    // Stop translating at undecodable instructions or once the block is
+    // full, and continue at the next PC. Undecodable instructions are
+    // reported when the next block is looked up.
+    if (!Inst) {
+      if (B->NumInsts == 0)
+        return nullptr;
+      AAPMicroOp Op = {};
+      Op.Kind = UOP_GOTO;
+      Op.PC = PC;
+      B->Ops.push_back(Op);
+      break;
+    }
+
+    AAPMicroOp Op = {};
+    Op.Kind = getMicroOpKind(Inst->Opcode);
+    Op.Inst = Inst;
+    Op.PC = PC;
+    Op.Size = Inst->Size;
+    Op.Imm = Inst->Imm;
+
+    // Stores list their base register first, and take the stored value as
+    // their second register operand.
+    Op.Rd = Inst->Regs[0];
+    Op.Ra = Inst->Regs[1];
+    Op.Rb = Inst->Regs[2];
+
+    // Shift amounts only use the bottom four bits
+    switch (Op.Kind) {
+    default:
+      break;
+    case UOP_ASRI:
+    case UOP_LSLI:
+    case UOP_LSRI:
+      Op.Imm &= 0xf;
+      break;
+    }
+
+    B->Ops.push_back(Op);
+    ++B->NumInsts;
+    PC += Inst->Size;
+
+    if (Op.Kind > UOP_FIRST_TERMINATOR)
+      break;
+
+    // Unknown instructions always trap, so there is no need to go further
+    if (!isKnownOpcode(Inst->Opcode))
+      break;
+  }
+
+  AAPBlock *Result = B.get();
+  Blocks[pc_w] = std::move(B);
+  return Result;
+}
+
+// The carry (or borrow) out of an unsigned 16-bit addition or subtraction
+// is bit 16 of the result
+static inline uint16_t getCarry(uint32_t Res) { return (Res >> 16) & 1; }
+
+// Labels as values and computed gotos are GNU extensions, which -pedantic
+// warns about at every use
+#if AAP_THREADED_DISPATCH
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+SimStatus AAPBlockEngine::run(uint64_t MaxInsts, uint64_t &Retired) {
+#if AAP_THREADED_DISPATCH
+  static const void *const Labels[] = {
+#define AAP_MICRO_OP_LABEL(Name) &&L_##Name,
+      AAP_MICRO_OPS(AAP_MICRO_OP_LABEL)
+#undef AAP_MICRO_OP_LABEL
+  };
+  DispatchTable = Labels;
+#define OPCODE(Name) L_##Name
+#define DISPATCH() goto *Op->Handler
+#else
+#define OPCODE(Name) case UOP_##Name
+#define DISPATCH() goto Dispatch
+#endif
+
+// Advance to the next micro-op in the block
+#define NEXT()                                                                 \
+  do {                                                                         \
+    ++Op;                                                                      \
+    DISPATCH();                                                                \
+  } while (0)
+
+// Leave the block part way through on an invalid memory access
+#define MEM_EXCEPT()                                                           \
+  do {                                                                         \
+    Status = SimStatus::SIM_EXCEPT_MEM;                                        \
+    goto Except;                                                               \
+  } while (0)
+
+// Leave the block through the given successor slot
+#define EXIT(Slot, Target)                                                     \
+  do {                                                                         \
+    ExitSlot = (Slot);                                                         \
+    NextPC = (Target);                                                         \
+    goto BlockExit;                                                            \
+  } while (0)
+
+  // Blocks translated before code memory was last written are stale
+  if (Generation != DecodeCache.getGeneration())
+    flush();
+
+  State.resetStatus();
+
+  Retired = 0;
+  uint32_t NextPC = State.getPC();
+  unsigned ExitSlot = 0;
+  SimStatus Status = SimStatus::SIM_OK;
+
+  AAPBlock *B = getBlock(NextPC);
+  if (!B)
+    goto DecodeFail;
+  const AAPMicroOp *Op;
+  Op = B->Ops.data();
+
+  // Blocks are only entered if they fit in the remaining budget, so that
+  // the budget is never exceeded
+  if (B->NumInsts > MaxInsts)
+    return SimStatus::SIM_OK;
+
+  // Resolve the handlers of newly translated blocks
+#if AAP_THREADED_DISPATCH
+#define RESOLVE_HANDLERS(Blk)                                                  \
+  do {                                                                         \
+    if (!(Blk)->Ops.front().Handler)                                           \
+      for (AAPMicroOp &MOp : (Blk)->Ops)                                       \
+        MOp.Handler = DispatchTable[MOp.Kind];                                 \
+  } while (0)
+#else
+#define RESOLVE_HANDLERS(Blk)                                                  \
+  do {                                                                         \
+  } while (0)
+#endif
+  RESOLVE_HANDLERS(B);
+  DISPATCH();
+
+#if !AAP_THREADED_DISPATCH
+Dispatch:
+  switch (Op->Kind) {
+  default:
+    llvm_unreachable("Invalid micro-op");
+#endif
+
+  // Moves
+  OPCODE(MOV): {
+    State.writeReg(Op->Rd, State.readReg(Op->Ra));
+    NEXT();
+  }
+  OPCODE(MOVI): {
+    State.writeReg(Op->Rd, static_cast<uint16_t>(Op->Imm));
+    NEXT();
+  }
+
+  // Arithmetic, setting the carry bit
+#define ARITH_R(Name, Expr)                                                    \
+  OPCODE(Name): {                                                              \
+    uint32_t ValA = State.readReg(Op->Ra);                                      \
+    uint32_t ValB = State.readReg(Op->Rb);                                      \
+    uint32_t Res = Expr;                                                       \
+    State.writeReg(Op->Rd, static_cast<uint16_t>(Res));                          \
+    State.setOverflow(getCarry(Res));                                          \
+    NEXT();                                                                    \
+  }
+#define ARITH_I(Name, Expr)                                                    \
+  OPCODE(Name): {                                                              \
+    uint32_t ValA = State.readReg(Op->Ra);                                      \
+    uint32_t ValB = static_cast<uint32_t>(Op->Imm);                            \
+    uint32_t Res = Expr;                                                       \
+    State.writeReg(Op->Rd, static_cast<uint16_t>(Res));                          \
+    State.setOverflow(getCarry(Res));                                          \
+    NEXT();                                                                    \
+  }
+  ARITH_R(ADD, ValA + ValB)
+  ARITH_R(ADDC, ValA + ValB + State.getOverflow())
+  ARITH_I(ADDI, ValA + ValB)
+  ARITH_R(SUB, ValA - ValB)
+  ARITH_R(SUBC, ValA - ValB - State.getOverflow())
+  ARITH_I(SUBI, ValA - ValB)
+#undef ARITH_R
+#undef ARITH_I
+
+  // Logical operations and shifts
+#define LOGIC_R(Name, Expr)                                                    \
+  OPCODE(Name): {                                                              \
+    uint16_t ValA = State.readReg(Op->Ra);                                      \
+    uint16_t ValB = State.readReg(Op->Rb);                                      \
+    State.writeReg(Op->Rd, static_cast<uint16_t>(Expr));                         \
+    NEXT();                                                                    \
+  }
+#define LOGIC_I(Name, Expr)                                                    \
+  OPCODE(Name): {                                                              \
+    uint16_t ValA = State.readReg(Op->Ra);                                      \
+    uint16_t ValB = static_cast<uint16_t>(Op->Imm);                            \
+    State.writeReg(Op->Rd, static_cast<uint16_t>(Expr));                         \
+    NEXT();                                                                    \
+  }
+  LOGIC_R(AND, ValA & ValB)
+  LOGIC_I(ANDI, ValA & ValB)
+  LOGIC_R(OR, ValA | ValB)
+  LOGIC_I(ORI, ValA | ValB)
+  LOGIC_R(XOR, ValA ^ ValB)
+  LOGIC_I(XORI, ValA ^ ValB)
+  LOGIC_R(ASR, static_cast<int16_t>(ValA) >> (ValB & 0xf))
+  LOGIC_I(ASRI, static_cast<int16_t>(ValA) >> ValB)
+  LOGIC_R(LSL, ValA << (ValB & 0xf))
+  LOGIC_I(LSLI, ValA << ValB)
+  LOGIC_R(LSR, ValA >> (ValB & 0xf))
+  LOGIC_I(LSRI, ValA >> ValB)
+#undef LOGIC_R
+#undef LOGIC_I
+
+  // Loads. The base register is written back before the load, and again
+  // after it for post-increment. A word access starting at the last byte of
+  // data memory faults after the base register is written back.
+#define LOAD(Name, Word, PreDec, PostInc)                                      \
+  OPCODE(Name): {                                                              \
+    uint16_t Base = State.readReg(Op->Ra);                                     \
+    uint16_t Offset = static_cast<uint16_t>(Op->Imm);                          \
+    if (PreDec)                                                                \
+      Base -= Offset;                                                          \
+    State.writeReg(Op->Ra, Base);                                              \
+    uint16_t Address = (PreDec || PostInc) ? Base : Base + Offset;             \
+    uint16_t Val;                                                              \
+    if (Word) {                                                                \
+      if (LLVM_UNLIKELY(Address == 0xffff))                                    \
+        MEM_EXCEPT();                                                          \
+      Val = State.readDataWord(Address);                                       \
+    } else {                                                                   \
+      Val = State.readDataByte(Address);                                       \
+    }                                                                          \
+    State.writeReg(Op->Rd, Val);                                               \
+    if (PostInc)                                                               \
+      State.writeReg(Op->Ra, Base + Offset);                                   \
+    NEXT();                                                                    \
+  }
+  LOAD(LDB, false, false, false)
+  LOAD(LDW, true, false, false)
+  LOAD(LDB_POSTINC, false, false, true)
+  LOAD(LDW_POSTINC, true, false, true)
+  LOAD(LDB_PREDEC, false, true, false)
+  LOAD(LDW_PREDEC, true, true, false)
+#undef LOAD
+
+  // Stores. Rd holds the base register and Ra the value to store. A word
+  // store starting at the last byte of data memory writes its low byte
+  // before faulting.
+#define STORE(Name, Word, PreDec, PostInc)                                     \
+  OPCODE(Name): {                                                              \
+    uint16_t Base = State.readReg(Op->Rd);                                     \
+    uint16_t Val = State.readReg(Op->Ra);                                      \
+    uint16_t Offset = static_cast<uint16_t>(Op->Imm);                          \
+    if (PreDec)                                                                \
+      Base -= Offset;                                                          \
+    State.writeReg(Op->Rd, Base);                                              \
+    uint16_t Address = (PreDec || PostInc) ? Base : Base + Offset;             \
+    if (Word) {                                                                \
+      if (LLVM_UNLIKELY(Address == 0xffff)) {                                  \
+        State.writeDataByte(Address, Val & 0xff);                              \
+        MEM_EXCEPT();                                                          \
+      }                                                                        \
+      State.writeDataWord(Address, Val);                                       \
+    } else {                                                                   \
+      State.writeDataByte(Address, Val & 0xff);                                \
+    }                                                                          \
+    if (PostInc)                                                               \
+      State.writeReg(Op->Rd, Base + Offset);                                   \
+    NEXT();                                                                    \
+  }
+  STORE(STB, false, false, false)
+  STORE(STW, true, false, false)
+  STORE(STB_POSTINC, false, false, true)
+  STORE(STW_POSTINC, true, false, true)
+  STORE(STB_PREDEC, false, true, false)
+  STORE(STW_PREDEC, true, true, false)
+#undef STORE
+
+  // Anything else goes through the reference interpreter
+  OPCODE(EXEC): {
+    uint32_t NewPC = Op->PC + Op->Size;
+    Status = Sim.exec(*Op->Inst, Op->PC, NewPC);
+    if (Status != SimStatus::SIM_OK) {
+      countPartialBlock(*B, Op);
+      State.setPC(NewPC);
+      return Status;
+    }
+    NEXT();
+  }
+
+  OPCODE(FIRST_TERMINATOR):
+    llvm_unreachable("Invalid micro-op");
+
+  // Calls and jumps. Link registers only hold the low 16 bits of the PC.
+  OPCODE(BAL): {
+    State.writeReg(Op->Rd, static_cast<uint16_t>(Op->PC + Op->Size));
+    EXIT(0, Op->PC + Op->Imm);
+  }
+  OPCODE(JAL): {
+    State.writeReg(Op->Ra, static_cast<uint16_t>(Op->PC + Op->Size));
+    uint32_t Target = State.readReg(Op->Rd);
+    Stats.addCall(Op->PC, Target);
+    EXIT(0, Target);
+  }
+  OPCODE(JMP): {
+    EXIT(0, State.readReg(Op->Rd));
+  }
+  OPCODE(BRA): {
+    EXIT(0, Op->PC + Op->Imm);
+  }
+
+  // Conditional branches exit through slot 1 when taken
+#define BRCC(Name, Type, Cond)                                                 \
+  OPCODE(Name): {                                                              \
+    Type ValA = static_cast<Type>(State.readReg(Op->Rd));                       \
+    Type ValB = static_cast<Type>(State.readReg(Op->Ra));                       \
+    if (Cond)                                                                  \
+      EXIT(1, Op->PC + Op->Imm);                                               \
+    EXIT(0, Op->PC + Op->Size);                                                \
+  }
+  BRCC(BEQ, uint16_t, ValA == ValB)
+  BRCC(BNE, uint16_t, ValA != ValB)
+  BRCC(BLTS, int16_t, ValA < ValB)
+  BRCC(BLES, int16_t, ValA <= ValB)
+  BRCC(BLTU, uint16_t, ValA < ValB)
+  BRCC(BLEU, uint16_t, ValA <= ValB)
+#undef BRCC
+
+  // Continue into the next block without executing anything
+  OPCODE(GOTO): {
+    EXIT(0, Op->PC);
+  }
+
+#if !AAP_THREADED_DISPATCH
+  } // end micro-op switch
+#endif
+
+BlockExit: {
+  Retired += B->NumInsts;
+  ++B->ExitCount[ExitSlot];
+  if (NextPC > 0xffffff) {
+    State.setPC(Op->PC);
+    return SimStatus::SIM_EXCEPT_REG;
+  }
+  if (LLVM_UNLIKELY(Sim.isStopRequested())) {
+    State.setPC(NextPC);
+    return SimStatus::SIM_TIMEOUT;
+  }
+
+  // Follow the chained successor if there is one, otherwise find the block
+  // and remember it for next time.
+  AAPBlock *Next;
+  if (B->SuccPC[ExitSlot] == NextPC) {
+    Next = B->Succ[ExitSlot];
+  } else {
+    Next = getBlock(NextPC);
+    if (!Next)
+      goto DecodeFail;
+    RESOLVE_HANDLERS(Next);
+    B->Succ[ExitSlot] = Next;
+    B->SuccPC[ExitSlot] = NextPC;
+  }
+  if (Next->NumInsts > MaxInsts - Retired) {
+    State.setPC(NextPC);
+    return SimStatus::SIM_OK;
+  }
+  B = Next;
+  Op = B->Ops.data();
+  DISPATCH();
+}
+
+Except:
+  // An exception was raised part way through an instruction. As in the
+  // reference interpreter the PC moves past the faulting instruction.
+  countPartialBlock(*B, Op);
+  State.setPC(Op->PC + Op->Size);
+  return Status;
+
+DecodeFail:
+  // Unable to read/decode an instruction. If the memory system threw an
+  // exception, pass this on, otherwise return invalid instruction.
+  State.setPC(NextPC);
+  if (State.getStatus() != SimStatus::SIM_OK)
+    return State.getStatus();
+  return SimStatus::SIM_INVALID_INSN;
+
+#undef OPCODE
+#undef DISPATCH
+#undef NEXT
+#undef MEM_EXCEPT
+#undef EXIT
+#undef RESOLVE_HANDLERS
+}
+
+#if AAP_THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,103 @@
+//===-- AAPBlockEngine.h - AAP Simulator Block Translation Engine -*- C++ -*-//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides a basic block translating execution engine for the AAP
+// simulator.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_AAPSIMULATOR_AAPBLOCKENGINE_H
+#define LLVM_LIB_TARGET_AAPSIMULATOR_AAPBLOCKENGINE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "AAPDecodeCache.h"
+#include "AAPSimState.h"
+#include "AAPSimStats.h"
+#include <memory>
+#include <vector>
+
+namespace AAPSim {
+
+class AAPSimulator;
+
+/// AAPMicroOp - a single translated instruction. Operands are fully resolved
+/// at translation time, and Handler points directly at the code which
+/// executes the operation.
+struct AAPMicroOp {
+  const void *Handler;          // Dispatch target
+  const AAPDecodedInst *Inst;   // Source instruction, for slow path ops
+  uint32_t PC;                  // Word address of the instruction
+  int32_t Imm;                  // Immediate operand
+  uint16_t Kind;                // Micro-op kind
+  uint8_t Rd, Ra, Rb;           // Register operands
+  uint8_t Size;                 // Instruction size in words
+};
+
+/// AAPBlock - a translated run of straight-line code, ending in a branch or
+/// jump. Up to two successor blocks are remembered so that execution can
+/// chain directly from one block to the next.
+struct AAPBlock {
+  std::vector<AAPMicroOp> Ops;
+  uint32_t NumInsts;
+
+  // Chained successors, indexed by exit slot
+  AAPBlock *Succ[2];
+  uint32_t SuccPC[2];
+
+  // Number of times the block has been run to completion through each exit
+  // slot, since statistics were last collected
+  uint64_t ExitCount[2];
+};
+
+/// AAPBlockEngine - executes code by translating it into blocks of
+/// pre-resolved micro-ops which are run with threaded dispatch.
+class AAPBlockEngine {
+  AAPSimulator &Sim;
+  AAPSimState &State;
+  const AAPDecodeCache &DecodeCache;
+  AAPSimStats &Stats;
+
+  llvm::DenseMap<uint32_t, std::unique_ptr<AAPBlock>> Blocks;
+  uint64_t Generation;
+
+  // Handlers for each micro-op kind, set up by the execution loop
+  const void *const *DispatchTable;
+
+  AAPBlockEngine(const AAPBlockEngine&) = delete;
+
+  /// Find or create the block starting at pc_w
+  AAPBlock *getBlock(uint32_t pc_w);
+  AAPBlock *translate(uint32_t pc_w);
+
+  /// Count the ops of B up to and including Last, for blocks which are left
+  /// part way through
+  void countPartialBlock(const AAPBlock &B, const AAPMicroOp *Last);
+
+public:
+  AAPBlockEngine(AAPSimulator &Sim, AAPSimState &State,
+                 const AAPDecodeCache &DecodeCache, AAPSimStats &Stats);
+
+  /// Execute from the current PC until a non-OK status is raised, the
+  /// simulator is asked to stop, or the next block would take the number of
+  /// retired instructions past MaxInsts. Retired is set to the number of
+  /// instructions run to completion.
+  SimStatus run(uint64_t MaxInsts, uint64_t &Retired);
+
+  /// Drop all translated blocks
+  void flush();
+
+  /// Add the executions of translated blocks to the statistics. Blocks
+  /// only record how often they ran, so this must be called before the
+  /// statistics are read.
+  void collectStats();
+};
+
+} // End AAPSim namespace
+
+#endif
@@ -0,0 +1,47 @@
+//===-- AAPDecodeCache.cpp - AAP Simulator Decoded Instruction Cache ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides the implementation of the predecoded instruction cache
+//
+//===----------------------------------------------------------------------===//
+
+#include "AAPDecodeCache.h"
+#include <cstring>
+
+using namespace AAPSim;
+
+const AAPDecodedInst *AAPDecodeCache::insert(uint32_t pc_w,
+                                             const AAPDecodedInst &Inst) {
+  std::unique_ptr<AAPDecodedInst[]> &Page =
+      Pages[(pc_w >> PageBits) % NumPages];
+  if (!Page) {
+    Page.reset(new AAPDecodedInst[PageSize]);
+    std::memset(Page.get(), 0, sizeof(AAPDecodedInst) * PageSize);
+  }
+  AAPDecodedInst *Entry = &Page[pc_w & (PageSize - 1)];
+  *Entry = Inst;
+  return Entry;
+}
+
+void AAPDecodeCache::invalidate(uint32_t address_w) {
+  // A write to a word affects the instruction starting at that word, and
+  // any 32-bit instruction starting on the word before it.
+  ++Generation;
+  for (uint32_t pc_w = address_w - 1; pc_w != address_w + 1; ++pc_w) {
+    AAPDecodedInst *Page = Pages[(pc_w >> PageBits) % NumPages].get();
+    if (Page)
+      Page[pc_w & (PageSize - 1)].Size = 0;
+  }
+}
+
+void AAPDecodeCache::clear() {
+  ++Generation;
+  for (auto &Page : Pages)
+    Page.reset();
+}
@@ -0,0 +1,83 @@
+//===-- AAPDecodeCache.h - AAP Simulator Decoded Instruction Cache -*- C++ -*-//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides a cache of predecoded instructions for the AAP simulator
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_AAPSIMULATOR_AAPDECODECACHE_H
+#define LLVM_LIB_TARGET_AAPSIMULATOR_AAPDECODECACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace AAPSim {
+
+/// AAPDecodedInst - compact predecoded form of a single instruction.
+///
+/// Register operands are stored as register file indices in the order they
+/// appear in the MCInst, and the (at most one) immediate operand is stored
+/// already sign extended, so that executing the instruction never needs to
+/// go back to the MC layer.
+struct AAPDecodedInst {
+  uint16_t Opcode;  // AAP::* opcode
+  uint8_t Size;     // Size in words, 0 if this entry holds no instruction
+  uint8_t Regs[3];  // Register operands
+  int32_t Imm;      // Immediate operand
+
+  bool isValid() const { return Size != 0; }
+};
+
+/// AAPDecodeCache - maps word addresses in code memory to their predecoded
+/// instructions.
+///
+/// The 24-bit code space is split into pages which are only allocated once
+/// an instruction within them has been decoded, so only code which is
+/// actually executed costs memory.
+class AAPDecodeCache {
+  static const unsigned PageBits = 10;
+  static const unsigned PageSize = 1u << PageBits;
+  static const unsigned NumPages = (1u << 24) >> PageBits;
+
+  std::vector<std::unique_ptr<AAPDecodedInst[]>> Pages;
+
+  // Incremented whenever cached instructions are invalidated, so that users
+  // of the cache can tell when anything derived from it is stale.
+  uint64_t Generation;
+
+  AAPDecodeCache(const AAPDecodeCache&) = delete;
+
+public:
+  AAPDecodeCache() : Pages(NumPages), Generation(0) {}
+
+  /// Return the cached instruction at pc_w, or nullptr if there is none
+  const AAPDecodedInst *lookup(uint32_t pc_w) const {
+    const AAPDecodedInst *Page = Pages[(pc_w >> PageBits) % NumPages].get();
+    if (!Page)
+      return nullptr;
+    const AAPDecodedInst *Inst = &Page[pc_w & (PageSize - 1)];
+    return Inst->isValid() ? Inst : nullptr;
+  }
+
+  /// Record the decoded form of the instruction at pc_w
+  const AAPDecodedInst *insert(uint32_t pc_w, const AAPDecodedInst &Inst);
+
+  /// Drop any cached instruction overlapping the code word at address_w
+  void invalidate(uint32_t address_w);
+
+  /// Drop every cached instruction
+  void clear();
+
+  uint64_t getGeneration() const { return Generation; }
+};
+
+} // End AAPSim namespace
+
+#endif
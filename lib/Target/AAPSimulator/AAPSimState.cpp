@@ -11,38 +11,114 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/BinaryStreamReader.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 #include "AAPSimState.h"
+#include "AAPDecodeCache.h"
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+
+#ifdef LLVM_ON_UNIX
+#include <sys/mman.h>
+#endif
 
 using namespace AAPSim;
 
-AAPSimState::AAPSimState() {
+AAPSimObserver::~AAPSimObserver() {}
+
+namespace {
+/// AAPSimTracer - observer which prints each access to dbgs()
+class AAPSimTracer : public AAPSimObserver {
+public:
+  void regRead(unsigned reg, uint16_t val) override {
+    llvm::dbgs() << " REG READ: " << reg << ": 0x"
+                 << llvm::format("%04" PRIx64, val) << "\n";
+  }
+  void regWrite(unsigned reg, uint16_t val) override {
+    llvm::dbgs() << " REG WRITE: " << reg << ": 0x"
+                 << llvm::format("%04" PRIx64, val) << "\n";
+  }
+  void codeMemRead(uint32_t address, uint8_t val) override {
+    llvm::dbgs() << " CODEMEM READ: 0x"
+                 << llvm::format("%07" PRIx64, address) << ": 0x"
+                 << llvm::format("%02" PRIx64, val) << "\n";
+  }
+  void codeMemWrite(uint32_t address, uint8_t val) override {
+    llvm::dbgs() << " CODEMEM WRITE: 0x"
+                 << llvm::format("%07" PRIx64, address) << ": 0x"
+                 << llvm::format("%02" PRIx64, val) << "\n";
+  }
+  void dataMemRead(uint32_t address, uint8_t val) override {
+    llvm::dbgs() << " DATAMEM READ: 0x"
+                 << llvm::format("%04" PRIx64, address) << ": 0x"
+                 << llvm::format("%02" PRIx64, val) << "\n";
+  }
+  void dataMemWrite(uint32_t address, uint8_t val) override {
+    llvm::dbgs() << " DATAMEM WRITE: 0x"
+                 << llvm::format("%04" PRIx64, address) << ": 0x"
+                 << llvm::format("%02" PRIx64, val) << "\n";
+  }
+};
+} // end anonymous namespace
+
+static AAPSimTracer Tracer;
+
+// Reserve zero filled memory which is committed lazily by the host,
+// releasing any memory previously held by Block
+static uint8_t *allocateMemory(llvm::sys::OwningMemoryBlock &Block,
+                               size_t Size) {
+  // Move assignment does not release the old block, so do so explicitly
+  { llvm::sys::OwningMemoryBlock Old(std::move(Block)); }
+
+  std::error_code EC;
+  llvm::sys::MemoryBlock MB = llvm::sys::Memory::allocateMappedMemory(
+      Size, nullptr, llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_WRITE,
+      EC);
+  if (EC)
+    llvm::report_fatal_error("Unable to allocate simulator memory: " +
+                             EC.message());
+  Block = llvm::sys::OwningMemoryBlock(MB);
+  return static_cast<uint8_t *>(Block.base());
+}
+
+AAPSimState::AAPSimState() : code_array(nullptr), decode_cache(nullptr) {
+  reset();
+  observer = nullptr;
+}
+
+AAPSimState::~AAPSimState() {
+  delete code_array;
+}
+
+void AAPSimState::reset() {
   for (int i = 0; i < 64; ++i)
     base_regs[i] = 0;
   pc_w = 0;
+  exitcode = 0;
+  overflow = 0;
 
-  // Code memory is 24-bit word addressed
-  code_memory = new uint8_t[0x1ffffff];
-  assert(code_memory && "Unable to allocate code memory");
+  // Code memory is 24-bit word addressed. Replacing the mappings is cheaper
+  // than clearing them, and drops any pages mapped from files.
+  code_memory = allocateMemory(code_block, CodeMemSize);
 
-  code_array = new llvm::ArrayRef<uint8_t>(code_memory, 0x1ffffff);
+  delete code_array;
+  code_array = new llvm::ArrayRef<uint8_t>(code_memory, CodeMemSize);
 
   // Data memory is 16-bit byte addressed
-  data_memory = new uint8_t[0xffff];
-  assert(data_memory && "Unable to allocate data memory");
+  data_memory = allocateMemory(data_block, DataMemSize);
+
+  code_dirty.assign(CodeMemSize / CodePageSize, 0);
 
   // We haven't hit any exception yet
   status = SimStatus::SIM_OK;
-
-  debug_trace = false;
-}
-
-AAPSimState::~AAPSimState() {
-  delete code_memory;
-  delete data_memory;
 }
 
 uint16_t AAPSimState::getReg(int reg) {
@@ -50,9 +126,8 @@ uint16_t AAPSimState::getReg(int reg) {
     status = SimStatus::SIM_EXCEPT_REG;
     return 0xffff;
   }
-  if (debug_trace)
-    llvm::dbgs() << " REG READ: " << reg << ": 0x"
-                 << llvm::format("%04" PRIx64, base_regs[reg]) << "\n";
+  if (observer)
+    observer->regRead(reg, base_regs[reg]);
   return base_regs[reg];
 }
 
@@ -61,9 +136,8 @@ void AAPSimState::setReg(int reg, uint16_t val) {
     status = SimStatus::SIM_EXCEPT_REG;
     return;
   }
-  if (debug_trace)
-    llvm::dbgs() << " REG WRITE: " << reg << ": 0x"
-                 << llvm::format("%04" PRIx64, val) << "\n";
+  if (observer)
+    observer->regWrite(reg, val);
   base_regs[reg] = val;
 }
 
@@ -84,10 +158,8 @@ uint8_t AAPSimState::getCodeMem(uint32_t address) {
     status = SimStatus::SIM_EXCEPT_MEM;
     return 0xff;
   }
-  if (debug_trace)
-    llvm::dbgs() << " CODEMEM READ: 0x"
-                 << llvm::format("%07" PRIx64, address) << ": 0x"
-                 << llvm::format("%02" PRIx64, code_memory[address]) << "\n";
+  if (observer)
+    observer->codeMemRead(address, code_memory[address]);
   return code_memory[address];
 }
 
@@ -96,22 +168,21 @@ void AAPSimState::setCodeMem(uint32_t address, uint8_t val) {
     status = SimStatus::SIM_EXCEPT_MEM;
     return;
   }
-  if (debug_trace)
-    llvm::dbgs() << " CODEMEM WRITE: 0x"
-                 << llvm::format("%07" PRIx64, address) << ": 0x"
-                 << llvm::format("%02" PRIx64, val) << "\n";
+  if (observer)
+    observer->codeMemWrite(address, val);
   code_memory[address] = val;
+  code_dirty[address / CodePageSize] = 1;
+  if (decode_cache)
+    decode_cache->invalidate(address >> 1);
 }
 
 uint8_t AAPSimState::getDataMem(uint32_t address) {
-    if (address > 0xffff) {
+  if (address > 0xffff) {
     status = SimStatus::SIM_EXCEPT_MEM;
     return 0xff;
   }
-  if (debug_trace)
-    llvm::dbgs() << " DATAMEM READ: 0x"
-                 << llvm::format("%04" PRIx64, address) << ": 0x"
-                 << llvm::format("%02" PRIx64, code_memory[address]) << "\n";
+  if (observer)
+    observer->dataMemRead(address, data_memory[address]);
   return data_memory[address];
 }
 
@@ -120,9 +191,202 @@ void AAPSimState::setDataMem(uint32_t address, uint8_t val) {
     status = SimStatus::SIM_EXCEPT_MEM;
     return;
   }
-  if (debug_trace)
-    llvm::dbgs() << " DATAMEM WRITE: 0x"
-                 << llvm::format("%04" PRIx64, address) << ": 0x"
-                 << llvm::format("%02" PRIx64, val) << "\n";
+  if (observer)
+    observer->dataMemWrite(address, val);
   data_memory[address] = val;
 }
+
+bool AAPSimState::getTracing() const {
+  return observer == &Tracer;
+}
+
+void AAPSimState::setTracing(bool enabled) {
+  if (enabled)
+    observer = &Tracer;
+  else if (observer == &Tracer)
+    observer = nullptr;
+}
+
+// Load Bytes into Mem at address, mapping whole pages from the file FD where
+// the file offset and memory address agree modulo the page size. Bytes in
+// partially covered pages are copied, so neighbouring data is preserved.
+static bool loadMemory(uint8_t *Mem, size_t MemSize, uint32_t address,
+                       llvm::StringRef Bytes, int FD, uint64_t FileOffset) {
+  if (address > MemSize || Bytes.size() > MemSize - address)
+    return false;
+
+  size_t Begin = 0, End = 0;
+#ifdef LLVM_ON_UNIX
+  const size_t PageSize = llvm::sys::Process::getPageSize();
+  if (FD >= 0 && (address % PageSize) == (FileOffset % PageSize)) {
+    Begin = llvm::alignTo(address, PageSize) - address;
+    End = llvm::alignDown(address + Bytes.size(), PageSize) - address;
+    if (Begin < End) {
+      void *Mapped = ::mmap(Mem + address + Begin, End - Begin,
+                            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                            FD, FileOffset + Begin);
+      if (Mapped == MAP_FAILED)
+        Begin = End = 0;
+    } else {
+      Begin = End = 0;
+    }
+  }
+#endif
+
+  // Copy anything which was not mapped
+  std::memcpy(Mem + address, Bytes.data(), Begin);
+  std::memcpy(Mem + address + End, Bytes.data() + End, Bytes.size() - End);
+  return true;
+}
+
+// Mark the pages covering Size bytes from address as dirty
+static void markDirty(std::vector<uint8_t> &Dirty, uint32_t PageSize,
+                      uint32_t address, size_t Size) {
+  if (!Size)
+    return;
+  std::fill(Dirty.begin() + address / PageSize,
+            Dirty.begin() + (address + Size - 1) / PageSize + 1, 1);
+}
+
+bool AAPSimState::loadCodeMem(uint32_t address, llvm::StringRef Bytes, int FD,
+                              uint64_t FileOffset) {
+  if (!loadMemory(code_memory, CodeMemSize, address, Bytes, FD, FileOffset))
+    return false;
+  markDirty(code_dirty, CodePageSize, address, Bytes.size());
+  if (decode_cache)
+    decode_cache->clear();
+  return true;
+}
+
+bool AAPSimState::loadDataMem(uint32_t address, llvm::StringRef Bytes, int FD,
+                              uint64_t FileOffset) {
+  return loadMemory(data_memory, DataMemSize, address, Bytes, FD, FileOffset);
+}
+
+// Snapshots are little endian, and hold a header followed by the registers,
+// special registers, and the pages of code and then data memory. Each list
+// of pages is preceded by the page size and number of pages, and each page
+// by its index. Pages which are entirely zero are omitted. Code memory is
+// too large to scan, so only its pages written since the last reset are
+// considered. Writes to data memory are not tracked, as they are made on the
+// fast path, so all of its pages are scanned.
+static const char SnapshotMagic[8] = {'A', 'A', 'P', 'S', 'N', 'A', 'P', 0};
+static const uint32_t SnapshotVersion = 1;
+
+static void savePages(llvm::support::endian::Writer &W, const uint8_t *Mem,
+                      uint32_t MemSize, uint32_t PageSize,
+                      const std::vector<uint8_t> *Dirty) {
+  std::vector<uint32_t> Pages;
+  for (uint32_t i = 0, e = MemSize / PageSize; i != e; ++i) {
+    const uint8_t *Page = Mem + i * PageSize;
+    if ((!Dirty || (*Dirty)[i]) &&
+        std::any_of(Page, Page + PageSize, [](uint8_t b) { return b != 0; }))
+      Pages.push_back(i);
+  }
+  W.write<uint32_t>(PageSize);
+  W.write<uint32_t>(Pages.size());
+  for (uint32_t i : Pages) {
+    W.write<uint32_t>(i);
+    W.OS.write(reinterpret_cast<const char *>(Mem + i * PageSize), PageSize);
+  }
+}
+
+// A page read from a snapshot, referring into the snapshot's buffer
+struct SnapshotPage {
+  uint32_t Index;
+  llvm::ArrayRef<uint8_t> Bytes;
+};
+
+static llvm::Error readPages(llvm::BinaryStreamReader &Reader,
+                             std::vector<SnapshotPage> &Pages,
+                             uint32_t PageSize, uint32_t NumMemPages) {
+  uint32_t SavedPageSize, NumPages;
+  if (auto Err = Reader.readInteger(SavedPageSize))
+    return Err;
+  if (auto Err = Reader.readInteger(NumPages))
+    return Err;
+  if (SavedPageSize != PageSize)
+    return llvm::make_error<llvm::StringError>(
+        "snapshot page size does not match", llvm::inconvertibleErrorCode());
+  for (uint32_t i = 0; i != NumPages; ++i) {
+    SnapshotPage Page;
+    if (auto Err = Reader.readInteger(Page.Index))
+      return Err;
+    if (Page.Index >= NumMemPages)
+      return llvm::make_error<llvm::StringError>(
+          "snapshot page out of range", llvm::inconvertibleErrorCode());
+    if (auto Err = Reader.readBytes(Page.Bytes, PageSize))
+      return Err;
+    Pages.push_back(Page);
+  }
+  return llvm::Error::success();
+}
+
+void AAPSimState::saveSnapshot(llvm::raw_ostream &OS) const {
+  llvm::support::endian::Writer W(OS, llvm::support::little);
+  OS.write(SnapshotMagic, sizeof(SnapshotMagic));
+  W.write<uint32_t>(SnapshotVersion);
+  W.write(llvm::makeArrayRef(base_regs));
+  W.write<uint32_t>(pc_w);
+  W.write<uint16_t>(exitcode);
+  W.write<uint16_t>(overflow);
+  savePages(W, code_memory, CodeMemSize, CodePageSize, &code_dirty);
+  savePages(W, data_memory, DataMemSize, DataPageSize, nullptr);
+}
+
+llvm::Error AAPSimState::restoreSnapshot(llvm::StringRef Snapshot) {
+  llvm::BinaryStreamReader Reader(Snapshot, llvm::support::little);
+  llvm::StringRef Magic;
+  uint32_t Version;
+  if (auto Err = Reader.readFixedString(Magic, sizeof(SnapshotMagic)))
+    return Err;
+  if (auto Err = Reader.readInteger(Version))
+    return Err;
+  if (Magic != llvm::StringRef(SnapshotMagic, sizeof(SnapshotMagic)) ||
+      Version != SnapshotVersion)
+    return llvm::make_error<llvm::StringError>(
+        "not an AAP simulator snapshot", llvm::inconvertibleErrorCode());
+
+  // Read and check the whole snapshot before changing any state, so that
+  // the state is left untouched if the snapshot is truncated or corrupt
+  uint16_t Regs[64];
+  uint32_t PC;
+  uint16_t ExitCode, Overflow;
+  for (uint16_t &Reg : Regs)
+    if (auto Err = Reader.readInteger(Reg))
+      return Err;
+  if (auto Err = Reader.readInteger(PC))
+    return Err;
+  if (PC > 0xffffff)
+    return llvm::make_error<llvm::StringError>(
+        "snapshot program counter out of range",
+        llvm::inconvertibleErrorCode());
+  if (auto Err = Reader.readInteger(ExitCode))
+    return Err;
+  if (auto Err = Reader.readInteger(Overflow))
+    return Err;
+  std::vector<SnapshotPage> CodePages, DataPages;
+  if (auto Err = readPages(Reader, CodePages, CodePageSize,
+                           CodeMemSize / CodePageSize))
+    return Err;
+  if (auto Err = readPages(Reader, DataPages, DataPageSize,
+                           DataMemSize / DataPageSize))
+    return Err;
+
+  reset();
+  std::memcpy(base_regs, Regs, sizeof(Regs));
+  pc_w = PC;
+  exitcode = ExitCode;
+  overflow = Overflow ? 1 : 0;
+  for (const SnapshotPage &Page : CodePages) {
+    std::memcpy(code_memory + Page.Index * CodePageSize, Page.Bytes.data(),
+                CodePageSize);
+    code_dirty[Page.Index] = 1;
+  }
+  for (const SnapshotPage &Page : DataPages)
+    std::memcpy(data_memory + Page.Index * DataPageSize, Page.Bytes.data(),
+                DataPageSize);
+  if (decode_cache)
+    decode_cache->clear();
+  return llvm::Error::success();
+}
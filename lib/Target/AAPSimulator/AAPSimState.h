@@ -15,10 +15,22 @@
 #define LLVM_LIB_TARGET_AAPSIMULATOR_AAPSIMSTATE_H
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Memory.h"
+#include <cassert>
 #include <cstdlib>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
 
 namespace AAPSim {
 
+class AAPDecodeCache;
+
 enum SimStatus {
   SIM_OK,           // Instruction executed
   SIM_INVALID_INSN, // Invalid instruction
@@ -30,6 +42,22 @@ enum SimStatus {
   SIM_TIMEOUT       // Simulator timeout
 };
 
+/// AAPSimObserver - interface for watching accesses made through the checked
+/// AAPSimState accessors, used for tracing. The fast accessors do not notify
+/// observers, so execution engines using them must only do so when no
+/// observer is attached.
+class AAPSimObserver {
+public:
+  virtual ~AAPSimObserver();
+
+  virtual void regRead(unsigned reg, uint16_t val) {}
+  virtual void regWrite(unsigned reg, uint16_t val) {}
+  virtual void codeMemRead(uint32_t address, uint8_t val) {}
+  virtual void codeMemWrite(uint32_t address, uint8_t val) {}
+  virtual void dataMemRead(uint32_t address, uint8_t val) {}
+  virtual void dataMemWrite(uint32_t address, uint8_t val) {}
+};
+
 /// AAPSimState - class representing processor state
 class AAPSimState {
   // Registers
@@ -38,23 +66,46 @@ class AAPSimState {
 
   // Special registers
   uint16_t exitcode;      // Exit code register
-  uint16_t overflow : 1;  // Overflow bit register
+  uint16_t overflow : 1;  // Carry bit, set by arithmetic operations
   SimStatus status;       // Simulator status
 
-  // One namespace code memory and data memory
+  // One namespace code memory and data memory. Both are anonymous mappings,
+  // so pages are only committed once they are written to.
+  llvm::sys::OwningMemoryBlock code_block;
+  llvm::sys::OwningMemoryBlock data_block;
   uint8_t *code_memory;
   uint8_t *data_memory;
   llvm::ArrayRef<uint8_t> *code_array;
 
-  bool debug_trace;
+  // Pages of code memory written since the last reset, so that snapshots
+  // only need to contain those pages. Data memory is small enough to be
+  // scanned in full, so writes to it are not tracked.
+  std::vector<uint8_t> code_dirty;
+
+  // Cache of instructions decoded from code memory, invalidated on writes
+  AAPDecodeCache *decode_cache;
+
+  // Observer of checked accesses, nullptr if there is none
+  AAPSimObserver *observer;
 
   AAPSimState(const AAPSimState&) = delete;
 
 
 public:
+  // Sizes of the code and data memories in bytes
+  static const uint32_t CodeMemSize = 0x2000000;
+  static const uint32_t DataMemSize = 0x10000;
+
+  // Granularity of the memory pages saved in snapshots, in bytes
+  static const uint32_t CodePageSize = 0x1000;
+  static const uint32_t DataPageSize = 0x100;
+
   AAPSimState();
   ~AAPSimState();
 
+  // Reset registers, special registers and memories to zero
+  void reset();
+
   // Read and write the registers
   uint16_t getReg(int reg);
   void setReg(int reg, uint16_t val);
@@ -67,11 +118,55 @@ public:
   uint8_t getCodeMem(uint32_t address);
   void setCodeMem(uint32_t address, uint8_t val);
   llvm::ArrayRef<uint8_t> *getCodeArray() { return code_array; }
+  void setDecodeCache(AAPDecodeCache *cache) { decode_cache = cache; }
 
   // Read and write data memory
   uint8_t getDataMem(uint32_t address);
   void setDataMem(uint32_t address, uint8_t val);
 
+  // Bulk load Bytes into code/data memory at a byte address. If FD is a
+  // valid file descriptor and Bytes are found at FileOffset in that file,
+  // whole pages are mapped copy-on-write from the file instead of being
+  // copied. Returns false if the bytes do not fit in memory.
+  bool loadCodeMem(uint32_t address, llvm::StringRef Bytes, int FD = -1,
+                   uint64_t FileOffset = 0);
+  bool loadDataMem(uint32_t address, llvm::StringRef Bytes, int FD = -1,
+                   uint64_t FileOffset = 0);
+
+  // Fast register and data memory accesses. These perform no range checks
+  // and do not notify the observer. Register numbers come from the decoder
+  // and so are always valid. Every 16-bit byte address is valid, but a word
+  // access must not start at the last byte of data memory.
+  uint16_t readReg(unsigned reg) const {
+    assert(reg < 64 && "Invalid register");
+    return base_regs[reg];
+  }
+  void writeReg(unsigned reg, uint16_t val) {
+    assert(reg < 64 && "Invalid register");
+    base_regs[reg] = val;
+  }
+  uint8_t readDataByte(uint16_t address) const {
+    return data_memory[address];
+  }
+  void writeDataByte(uint16_t address, uint8_t val) {
+    data_memory[address] = val;
+  }
+  uint16_t readDataWord(uint16_t address) const {
+    assert(address != 0xffff && "Word access out of range");
+    return llvm::support::endian::read16le(&data_memory[address]);
+  }
+  void writeDataWord(uint16_t address, uint16_t val) {
+    assert(address != 0xffff && "Word access out of range");
+    llvm::support::endian::write16le(&data_memory[address], val);
+  }
+
+  // Write the registers, special registers and written memory pages to a
+  // compact snapshot, and restore them from one. Restoring replaces the
+  // whole state, as if it had been reset first. If the snapshot is invalid,
+  // an error is returned and the state is left unchanged.
+  void saveSnapshot(llvm::raw_ostream &OS) const;
+  llvm::Error restoreSnapshot(llvm::StringRef Snapshot);
+
   // Special register accesses
   uint16_t getExitCode() const { return exitcode; }
   void setExitCode(uint16_t code) { exitcode = code; }
@@ -82,9 +177,12 @@ public:
   SimStatus getStatus() { return status; }
   void resetStatus() { status = SimStatus::SIM_OK; }
 
-  // Trace control
-  bool getTracing() const { return debug_trace; }
-  void setTracing(bool enabled) { debug_trace = enabled; }
+  // Observer control. Tracing installs an observer which prints every
+  // access to the debug stream.
+  AAPSimObserver *getObserver() const { return observer; }
+  void setObserver(AAPSimObserver *obs) { observer = obs; }
+  bool getTracing() const;
+  void setTracing(bool enabled);
 };
 
 } // End AAPSim namespace
@@ -0,0 +1,167 @@
+//===-- AAPSimStats.cpp - AAP Simulator Execution Statistics --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides the implementation of the execution statistics
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include "AAPDecodeCache.h"
+#include "AAPSimStats.h"
+#include <algorithm>
+
+#define GET_INSTRINFO_ENUM
+#include "AAPGenInstrInfo.inc"
+
+using namespace llvm;
+using namespace AAPSim;
+
+AAPSimStats::AAPSimStats(unsigned NumOpcodes)
+    : OpcodeCounts(NumOpcodes), Profiling(false) {
+  reset();
+}
+
+void AAPSimStats::reset() {
+  Insts = ShortInsts = LongInsts = 0;
+  BranchesTaken = BranchesNotTaken = 0;
+  ByteLoads = WordLoads = ByteStores = WordStores = 0;
+  std::fill(OpcodeCounts.begin(), OpcodeCounts.end(), 0);
+  InstCounts.clear();
+  CallCounts.clear();
+}
+
+void AAPSimStats::addInst(const AAPDecodedInst &Inst, uint32_t pc_w,
+                          uint64_t Count) {
+  Insts += Count;
+  if (Profiling)
+    InstCounts[pc_w] += Count;
+  if (Inst.Size == 1)
+    ShortInsts += Count;
+  else
+    LongInsts += Count;
+  if (Inst.Opcode < OpcodeCounts.size())
+    OpcodeCounts[Inst.Opcode] += Count;
+
+  switch (Inst.Opcode) {
+  default:
+    break;
+  case AAP::LDB:
+  case AAP::LDB_short:
+  case AAP::LDB_postinc:
+  case AAP::LDB_postinc_short:
+  case AAP::LDB_predec:
+  case AAP::LDB_predec_short:
+    ByteLoads += Count;
+    break;
+  case AAP::LDW:
+  case AAP::LDW_short:
+  case AAP::LDW_postinc:
+  case AAP::LDW_postinc_short:
+  case AAP::LDW_predec:
+  case AAP::LDW_predec_short:
+    WordLoads += Count;
+    break;
+  case AAP::STB:
+  case AAP::STB_short:
+  case AAP::STB_postinc:
+  case AAP::STB_postinc_short:
+  case AAP::STB_predec:
+  case AAP::STB_predec_short:
+    ByteStores += Count;
+    break;
+  case AAP::STW:
+  case AAP::STW_short:
+  case AAP::STW_postinc:
+  case AAP::STW_postinc_short:
+  case AAP::STW_predec:
+  case AAP::STW_predec_short:
+    WordStores += Count;
+    break;
+  }
+}
+
+AAPSimStats::BranchKind AAPSimStats::getBranchKind(unsigned Opcode) {
+  switch (Opcode) {
+  default:
+    return NotBranch;
+  case AAP::BEQ_:
+  case AAP::BEQ_short:
+  case AAP::BNE_:
+  case AAP::BNE_short:
+  case AAP::BLTS_:
+  case AAP::BLTS_short:
+  case AAP::BLES_:
+  case AAP::BLES_short:
+  case AAP::BLTU_:
+  case AAP::BLTU_short:
+  case AAP::BLEU_:
+  case AAP::BLEU_short:
+    return CondBranch;
+  case AAP::BRA:
+  case AAP::BRA_short:
+  case AAP::BAL:
+  case AAP::BAL_short:
+  case AAP::JMP:
+  case AAP::JMP_short:
+  case AAP::JAL:
+  case AAP::JAL_short:
+    return UncondBranch;
+  }
+}
+
+bool AAPSimStats::isCall(unsigned Opcode) {
+  switch (Opcode) {
+  default:
+    return false;
+  case AAP::BAL:
+  case AAP::BAL_short:
+  case AAP::JAL:
+  case AAP::JAL_short:
+    return true;
+  }
+}
+
+void AAPSimStats::printJSON(raw_ostream &OS, const MCInstrInfo &MII) const {
+  json::Object Opcodes;
+  for (unsigned Opc = 0, E = OpcodeCounts.size(); Opc != E; ++Opc)
+    if (OpcodeCounts[Opc])
+      Opcodes[MII.getName(Opc)] = static_cast<int64_t>(OpcodeCounts[Opc]);
+
+  json::Object Root{
+      {"instructions", static_cast<int64_t>(Insts)},
+      {"short_instructions", static_cast<int64_t>(ShortInsts)},
+      {"long_instructions", static_cast<int64_t>(LongInsts)},
+      {"branches_taken", static_cast<int64_t>(BranchesTaken)},
+      {"branches_not_taken", static_cast<int64_t>(BranchesNotTaken)},
+      {"byte_loads", static_cast<int64_t>(ByteLoads)},
+      {"word_loads", static_cast<int64_t>(WordLoads)},
+      {"byte_stores", static_cast<int64_t>(ByteStores)},
+      {"word_stores", static_cast<int64_t>(WordStores)},
+      {"opcodes", std::move(Opcodes)}};
+  OS << formatv("{0:2}", json::Value(std::move(Root))) << "\n";
+}
+
+void AAPSimStats::printCSV(raw_ostream &OS, const MCInstrInfo &MII) const {
+  OS << "counter,value\n"
+     << "instructions," << Insts << "\n"
+     << "short_instructions," << ShortInsts << "\n"
+     << "long_instructions," << LongInsts << "\n"
+     << "branches_taken," << BranchesTaken << "\n"
+     << "branches_not_taken," << BranchesNotTaken << "\n"
+     << "byte_loads," << ByteLoads << "\n"
+     << "word_loads," << WordLoads << "\n"
+     << "byte_stores," << ByteStores << "\n"
+     << "word_stores," << WordStores << "\n";
+  for (unsigned Opc = 0, E = OpcodeCounts.size(); Opc != E; ++Opc)
+    if (OpcodeCounts[Opc])
+      OS << "opcode." << MII.getName(Opc) << "," << OpcodeCounts[Opc] << "\n";
+}
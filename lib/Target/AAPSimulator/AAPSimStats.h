@@ -0,0 +1,96 @@
+//===-- AAPSimStats.h - AAP Simulator Execution Statistics -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides counters of the dynamic behaviour of simulated code
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_AAPSIMULATOR_AAPSIMSTATS_H
+#define LLVM_LIB_TARGET_AAPSIMULATOR_AAPSIMSTATS_H
+
+#include "llvm/ADT/DenseMap.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class MCInstrInfo;
+class raw_ostream;
+}
+
+namespace AAPSim {
+
+struct AAPDecodedInst;
+
+/// AAPSimStats - counts of executed instructions.
+///
+/// Instructions are counted as they are executed, including the instruction
+/// which raised the final simulator status. Branch outcomes are counted
+/// separately since they are only known once the branch has executed.
+struct AAPSimStats {
+  uint64_t Insts;             // Executed instructions
+  uint64_t ShortInsts;        // Executed 16-bit instructions
+  uint64_t LongInsts;         // Executed 32-bit instructions
+  uint64_t BranchesTaken;     // Taken branches, jumps and calls
+  uint64_t BranchesNotTaken;  // Untaken conditional branches
+  uint64_t ByteLoads;
+  uint64_t WordLoads;
+  uint64_t ByteStores;
+  uint64_t WordStores;
+
+  // Executed instructions, indexed by opcode
+  std::vector<uint64_t> OpcodeCounts;
+
+  // Per instruction and per call edge counts, only collected when profiling
+  // is enabled. Addresses are code word addresses, and call edges are keyed
+  // by the address of the call and of its target.
+  bool Profiling;
+  llvm::DenseMap<uint32_t, uint64_t> InstCounts;
+  llvm::DenseMap<std::pair<uint32_t, uint32_t>, uint64_t> CallCounts;
+
+  enum BranchKind {
+    NotBranch,    // Does not change control flow
+    CondBranch,   // Conditional branch
+    UncondBranch  // Unconditional branch, jump or call
+  };
+
+  explicit AAPSimStats(unsigned NumOpcodes);
+
+  /// Count Count executions of Inst at pc_w
+  void addInst(const AAPDecodedInst &Inst, uint32_t pc_w, uint64_t Count = 1);
+
+  /// Count Count calls from pc_w to target_w
+  void addCall(uint32_t pc_w, uint32_t target_w, uint64_t Count = 1) {
+    if (Profiling)
+      CallCounts[std::make_pair(pc_w, target_w)] += Count;
+  }
+
+  /// Count the outcomes of executed branches
+  void addBranches(uint64_t Taken, uint64_t NotTaken) {
+    BranchesTaken += Taken;
+    BranchesNotTaken += NotTaken;
+  }
+
+  /// Reset all counters to zero
+  void reset();
+
+  /// Classify an opcode by the way it changes control flow
+  static BranchKind getBranchKind(unsigned Opcode);
+
+  /// Whether an opcode is a call (branch or jump and link)
+  static bool isCall(unsigned Opcode);
+
+  /// Print the counters, naming opcodes using MII
+  void printJSON(llvm::raw_ostream &OS, const llvm::MCInstrInfo &MII) const;
+  void printCSV(llvm::raw_ostream &OS, const llvm::MCInstrInfo &MII) const;
+};
+
+} // End AAPSim namespace
+
+#endif
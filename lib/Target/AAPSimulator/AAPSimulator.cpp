@@ -23,6 +23,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/Threading.h"
 #include "AAPSimulator.h"
 #include <cstring>
 
@@ -43,7 +44,28 @@ static cl::opt<bool> Trace("trace");
 // Register and memory exception handlers
 #define EXCEPT(x) x; if (State.getStatus() != SimStatus::SIM_OK) return State.getStatus()
 
-AAPSimulator::AAPSimulator() {
+extern "C" void LLVMInitializeAAPTargetInfo();
+extern "C" void LLVMInitializeAAPTargetMC();
+extern "C" void LLVMInitializeAAPDisassembler();
+
+void AAPSim::initialize() {
+  static llvm::once_flag InitializeFlag;
+  llvm::call_once(InitializeFlag, []() {
+    LLVMInitializeAAPTargetInfo();
+    LLVMInitializeAAPTargetMC();
+    LLVMInitializeAAPDisassembler();
+  });
+}
+
+AAPSimulator::AAPSimulator()
+    : Stats(AAP::INSTRUCTION_LIST_END),
+      BlockEngine(*this, State, DecodeCache, Stats), Engine(SimEngine::Block),
+      StopRequested(false), Out(&outs()), Err(&errs()) {
+  // Writes to code memory must invalidate any instructions decoded from it
+  State.setDecodeCache(&DecodeCache);
+
+  initialize();
+
   std::string Error;
   TheTarget = TargetRegistry::lookupTarget("aap-none-none", Error);
   if (!TheTarget) {
@@ -63,7 +85,8 @@ AAPSimulator::AAPSimulator() {
     return;
   }
 
-  STI = TheTarget->createMCSubtargetInfo("aap-none-none", "", "");
+  // Decode the instructions of all optional units
+  STI = TheTarget->createMCSubtargetInfo("aap-none-none", "", "+muldiv");
   if (!STI) {
     errs() << "error: no subtarget info\n";
     return;
@@ -75,10 +98,12 @@ AAPSimulator::AAPSimulator() {
     return;
   }
 
-  const MCObjectFileInfo *MOFI = new MCObjectFileInfo();
-  MCContext Ctx(AsmInfo, MRI, MOFI);
+  // The disassembler keeps a reference to the context, so it must live as
+  // long as the simulator
+  MOFI = new MCObjectFileInfo();
+  Ctx = new MCContext(AsmInfo, MRI, MOFI);
 
-  DisAsm = TheTarget->createMCDisassembler(*STI, Ctx);
+  DisAsm = TheTarget->createMCDisassembler(*STI, *Ctx);
   if (!DisAsm) {
     errs() << "error: no disassembler\n";
     return;
@@ -93,16 +118,34 @@ AAPSimulator::AAPSimulator() {
   }
 }
 
-void AAPSimulator::WriteCodeSection(llvm::StringRef Bytes, uint32_t address) {
-  for (size_t i = 0; i < Bytes.size(); i++) {
-    State.setCodeMem(address + i, Bytes[i]);
-  }
+void AAPSimulator::reset() {
+  StopRequested.store(false, std::memory_order_relaxed);
+  State.reset();
+  DecodeCache.clear();
+  BlockEngine.flush();
+  Stats.reset();
 }
 
-void AAPSimulator::WriteDataSection(llvm::StringRef Bytes, uint32_t address) {
-  for (size_t i = 0; i < Bytes.size(); i++) {
-    State.setDataMem(address + i, Bytes[i]);
-  }
+Error AAPSimulator::restoreSnapshot(StringRef Snapshot) {
+  // The state is only replaced, and what was derived from it dropped, once
+  // the whole snapshot has been read
+  if (auto Err = State.restoreSnapshot(Snapshot))
+    return Err;
+  StopRequested.store(false, std::memory_order_relaxed);
+  DecodeCache.clear();
+  BlockEngine.flush();
+  Stats.reset();
+  return Error::success();
+}
+
+bool AAPSimulator::WriteCodeSection(llvm::StringRef Bytes, uint32_t address,
+                                    int FD, uint64_t FileOffset) {
+  return State.loadCodeMem(address, Bytes, FD, FileOffset);
+}
+
+bool AAPSimulator::WriteDataSection(llvm::StringRef Bytes, uint32_t address,
+                                    int FD, uint64_t FileOffset) {
+  return State.loadDataMem(address, Bytes, FD, FileOffset);
 }
 
 static int getLLVMReg(unsigned Reg) {
@@ -121,15 +164,6 @@ static int getLLVMReg(unsigned Reg) {
   }
 }
 
-// Function to sign extend a uint16_t register for detecting overflow
-static uint32_t signExtend16(uint16_t val) {
-  uint32_t newval = static_cast<uint16_t>(val);
-  uint32_t sign = newval & 0x8000;
-  if (sign)
-    newval |= 0xffff0000;
-  return newval;
-}
-
 // Sign extend branch cc target (long, 10 bits)
 static int16_t signExtendBranchCC(uint16_t val) {
   if (val & 0x0200)
@@ -163,8 +197,61 @@ static int16_t signExtendBranchCCS(uint16_t val) {
   return signExtendBranchAndLinkS(val);
 }
 
-SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
-  switch (Inst.getOpcode()) {
+// Convert a disassembled instruction into its predecoded form. Branch
+// targets are sign extended here so that exec can use them directly.
+static void decodeInst(const MCInst &MI, uint64_t Size, AAPDecodedInst &Inst) {
+  Inst.Opcode = MI.getOpcode();
+  Inst.Size = Size >> 1;
+  Inst.Regs[0] = Inst.Regs[1] = Inst.Regs[2] = 0;
+  Inst.Imm = 0;
+
+  unsigned NumRegs = 0;
+  for (const MCOperand &MO : MI) {
+    if (MO.isReg()) {
+      assert(NumRegs < 3 && "Too many register operands");
+      Inst.Regs[NumRegs++] = getLLVMReg(MO.getReg());
+    } else if (MO.isImm()) {
+      Inst.Imm = MO.getImm();
+    }
+  }
+
+  switch (Inst.Opcode) {
+  default:
+    break;
+  case AAP::BAL:
+    Inst.Imm = static_cast<int16_t>(Inst.Imm);
+    break;
+  case AAP::BAL_short:
+    Inst.Imm = signExtendBranchAndLinkS(Inst.Imm);
+    break;
+  case AAP::BEQ_:
+  case AAP::BNE_:
+  case AAP::BLTS_:
+  case AAP::BLES_:
+  case AAP::BLTU_:
+  case AAP::BLEU_:
+    Inst.Imm = signExtendBranchCC(Inst.Imm);
+    break;
+  case AAP::BEQ_short:
+  case AAP::BNE_short:
+  case AAP::BLTS_short:
+  case AAP::BLES_short:
+  case AAP::BLTU_short:
+  case AAP::BLEU_short:
+    Inst.Imm = signExtendBranchCCS(Inst.Imm);
+    break;
+  case AAP::BRA:
+    Inst.Imm = signExtendBranch(Inst.Imm);
+    break;
+  case AAP::BRA_short:
+    Inst.Imm = signExtendBranchS(Inst.Imm);
+    break;
+  }
+}
+
+SimStatus AAPSimulator::exec(const AAPDecodedInst &Inst, uint32_t pc_w,
+                              uint32_t &newpc_w) {
+  switch (Inst.Opcode) {
     // Unknown instruction
     default:
 #if UNKNOWN_SHOULD_UNREACHABLE
@@ -183,8 +270,8 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // 4: Write char Rd to stderr
     case AAP::NOP:
     case AAP::NOP_short: {
-      int Reg = getLLVMReg(Inst.getOperand(0).getReg());
-      uint16_t Command = Inst.getOperand(1).getImm();
+      int Reg = Inst.Regs[0];
+      uint16_t Command = Inst.Imm;
       // Load register value and char for NOPs that require it
       EXCEPT(uint16_t RegVal = State.getReg(Reg));
       char c = static_cast<char>(RegVal);
@@ -196,10 +283,10 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
           State.setExitCode(RegVal);
           return SimStatus::SIM_QUIT;
         case 3:
-          outs() << c;
+          *Out << c;
           break;
         case 4:
-          errs() << c;
+          *Err << c;
           break;
       }
       break;
@@ -208,15 +295,15 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // Move Instructions
     case AAP::MOV_r:
     case AAP::MOV_r_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrc = getLLVMReg(Inst.getOperand(1).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrc = Inst.Regs[1];
       EXCEPT(State.setReg(RegDst, State.getReg(RegSrc)));
       break;
     }
     case AAP::MOVI_i16:
     case AAP::MOVI_i6_short: {
-      int Reg = getLLVMReg(Inst.getOperand(0).getReg());
-      uint16_t Val = Inst.getOperand(1).getImm() & 0xffff;
+      int Reg = Inst.Regs[0];
+      uint16_t Val = Inst.Imm & 0xffff;
       EXCEPT(State.setReg(Reg, Val));
       break;
     }
@@ -224,101 +311,95 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // ADD
     case AAP::ADD_r:
     case AAP::ADD_r_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      int RegSrcB = getLLVMReg(Inst.getOperand(2).getReg());
-      EXCEPT(uint32_t ValA = signExtend16(State.getReg(RegSrcA)));
-      EXCEPT(uint32_t ValB = signExtend16(State.getReg(RegSrcB)));
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
+      EXCEPT(uint32_t ValA = State.getReg(RegSrcA));
+      EXCEPT(uint32_t ValB = State.getReg(RegSrcB));
       uint32_t Res = ValA + ValB;
       EXCEPT(State.setReg(RegDst, static_cast<uint16_t>(Res)));
-      // Test for overflow
-      int32_t Res_s = static_cast<int32_t>(Res);
-      State.setOverflow(static_cast<int16_t>(Res_s) != Res_s ? 1 : 0);
+      // The carry (or borrow) out is bit 16 of the result
+      State.setOverflow((Res >> 16) & 1);
       break;
     }
 
     // ADDC
     case AAP::ADDC_r: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      int RegSrcB = getLLVMReg(Inst.getOperand(2).getReg());
-      EXCEPT(uint32_t ValA = signExtend16(State.getReg(RegSrcA)));
-      EXCEPT(uint32_t ValB = signExtend16(State.getReg(RegSrcB)));
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
+      EXCEPT(uint32_t ValA = State.getReg(RegSrcA));
+      EXCEPT(uint32_t ValB = State.getReg(RegSrcB));
       uint32_t Res = ValA + ValB + State.getOverflow();
       EXCEPT(State.setReg(RegDst, static_cast<uint16_t>(Res)));
-      // Test for overflow
-      int32_t Res_s = static_cast<int32_t>(Res);
-      State.setOverflow(static_cast<int16_t>(Res_s) != Res_s ? 1 : 0);
+      // The carry (or borrow) out is bit 16 of the result
+      State.setOverflow((Res >> 16) & 1);
       break;
     }
 
     // ADDI
     case AAP::ADDI_i10:
     case AAP::ADDI_i3_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      EXCEPT(uint32_t ValA = signExtend16(State.getReg(RegSrcA)));
-      uint32_t ValB = Inst.getOperand(2).getImm();
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      EXCEPT(uint32_t ValA = State.getReg(RegSrcA));
+      uint32_t ValB = Inst.Imm;
       uint32_t Res = ValA + ValB;
       EXCEPT(State.setReg(RegDst, static_cast<uint16_t>(Res)));
-      // Test for overflow
-      int32_t Res_s = static_cast<int32_t>(Res);
-      State.setOverflow(static_cast<int16_t>(Res_s) != Res_s ? 1 : 0);
+      // The carry (or borrow) out is bit 16 of the result
+      State.setOverflow((Res >> 16) & 1);
       break;
     }
 
     // SUB
     case AAP::SUB_r:
     case AAP::SUB_r_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      int RegSrcB = getLLVMReg(Inst.getOperand(2).getReg());
-      EXCEPT(uint32_t ValA = signExtend16(State.getReg(RegSrcA)));
-      EXCEPT(uint32_t ValB = signExtend16(State.getReg(RegSrcB)));
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
+      EXCEPT(uint32_t ValA = State.getReg(RegSrcA));
+      EXCEPT(uint32_t ValB = State.getReg(RegSrcB));
       uint32_t Res = ValA - ValB;
       EXCEPT(State.setReg(RegDst, static_cast<uint16_t>(Res)));
-      // Test for overflow
-      int32_t Res_s = static_cast<int32_t>(Res);
-      State.setOverflow(static_cast<int16_t>(Res_s) != Res_s ? 1 : 0);
+      // The carry (or borrow) out is bit 16 of the result
+      State.setOverflow((Res >> 16) & 1);
       break;
     }
 
     // SUBC
     case AAP::SUBC_r: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      int RegSrcB = getLLVMReg(Inst.getOperand(2).getReg());
-      EXCEPT(uint32_t ValA = signExtend16(State.getReg(RegSrcA)));
-      EXCEPT(uint32_t ValB = signExtend16(State.getReg(RegSrcB)));
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
+      EXCEPT(uint32_t ValA = State.getReg(RegSrcA));
+      EXCEPT(uint32_t ValB = State.getReg(RegSrcB));
       uint32_t Res = ValA - ValB - State.getOverflow();
       EXCEPT(State.setReg(RegDst, static_cast<uint16_t>(Res)));
-      // Test for overflow
-      int32_t Res_s = static_cast<int32_t>(Res);
-      State.setOverflow(static_cast<int16_t>(Res_s) != Res_s ? 1 : 0);
+      // The carry (or borrow) out is bit 16 of the result
+      State.setOverflow((Res >> 16) & 1);
       break;
     }
 
     // SUBI
     case AAP::SUBI_i10:
     case AAP::SUBI_i3_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      EXCEPT(uint32_t ValA = signExtend16(State.getReg(RegSrcA)));
-      uint32_t ValB = Inst.getOperand(2).getImm();
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      EXCEPT(uint32_t ValA = State.getReg(RegSrcA));
+      uint32_t ValB = Inst.Imm;
       uint32_t Res = ValA - ValB;
       EXCEPT(State.setReg(RegDst, static_cast<uint16_t>(Res)));
-      // Test for overflow
-      int32_t Res_s = static_cast<int32_t>(Res);
-      State.setOverflow(static_cast<int16_t>(Res_s) != Res_s ? 1 : 0);
+      // The carry (or borrow) out is bit 16 of the result
+      State.setOverflow((Res >> 16) & 1);
       break;
     }
 
     // AND
     case AAP::AND_r:
     case AAP::AND_r_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      int RegSrcB = getLLVMReg(Inst.getOperand(2).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
       EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
       EXCEPT(uint16_t ValB = State.getReg(RegSrcB));
       uint16_t Res = ValA & ValB;
@@ -328,10 +409,10 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
 
     // ANDI
     case AAP::ANDI_i9: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
       EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
-      uint16_t ValB = Inst.getOperand(2).getImm();
+      uint16_t ValB = Inst.Imm;
       uint16_t Res = ValA & ValB;
       EXCEPT(State.setReg(RegDst, Res));
       break;
@@ -340,9 +421,9 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // OR
     case AAP::OR_r:
     case AAP::OR_r_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      int RegSrcB = getLLVMReg(Inst.getOperand(2).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
       EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
       EXCEPT(uint16_t ValB = State.getReg(RegSrcB));
       uint16_t Res = ValA | ValB;
@@ -352,10 +433,10 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
 
     // ORI
     case AAP::ORI_i9: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
       EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
-      uint16_t ValB = Inst.getOperand(2).getImm();
+      uint16_t ValB = Inst.Imm;
       uint16_t Res = ValA | ValB;
       EXCEPT(State.setReg(RegDst, Res));
       break;
@@ -364,9 +445,9 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // XOR
     case AAP::XOR_r:
     case AAP::XOR_r_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      int RegSrcB = getLLVMReg(Inst.getOperand(2).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
       EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
       EXCEPT(uint16_t ValB = State.getReg(RegSrcB));
       uint16_t Res = ValA ^ ValB;
@@ -376,10 +457,10 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
 
     // XORI
     case AAP::XORI_i9: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
       EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
-      uint16_t ValB = Inst.getOperand(2).getImm();
+      uint16_t ValB = Inst.Imm;
       uint16_t Res = ValA ^ ValB;
       EXCEPT(State.setReg(RegDst, Res));
       break;
@@ -388,9 +469,9 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // ASR
     case AAP::ASR_r:
     case AAP::ASR_r_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      int RegSrcB = getLLVMReg(Inst.getOperand(2).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
       EXCEPT(int16_t ValA = static_cast<int16_t>(State.getReg(RegSrcA)));
       EXCEPT(int16_t ValB = static_cast<int16_t>(State.getReg(RegSrcB) & 0xf));
       uint16_t Res = static_cast<uint16_t>(ValA >> ValB);
@@ -401,10 +482,10 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // ASRI
     case AAP::ASRI_i6:
     case AAP::ASRI_i3_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
       EXCEPT(int16_t ValA = static_cast<int16_t>(State.getReg(RegSrcA)));
-      int16_t ValB = static_cast<int16_t>(Inst.getOperand(2).getImm() & 0xf);
+      int16_t ValB = static_cast<int16_t>(Inst.Imm & 0xf);
       uint16_t Res = static_cast<uint16_t>(ValA >> ValB);
       EXCEPT(State.setReg(RegDst, Res));
       break;
@@ -413,9 +494,9 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // LSL
     case AAP::LSL_r:
     case AAP::LSL_r_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      int RegSrcB = getLLVMReg(Inst.getOperand(2).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
       EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
       EXCEPT(uint16_t ValB = State.getReg(RegSrcB) & 0xf);
       uint16_t Res = ValA << ValB;
@@ -426,10 +507,10 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // LSLI
     case AAP::LSLI_i6:
     case AAP::LSLI_i3_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
       EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
-      uint16_t ValB = Inst.getOperand(2).getImm() & 0xf;
+      uint16_t ValB = Inst.Imm & 0xf;
       uint16_t Res = ValA << ValB;
       EXCEPT(State.setReg(RegDst, Res));
       break;
@@ -438,9 +519,9 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // LSR
     case AAP::LSR_r:
     case AAP::LSR_r_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
-      int RegSrcB = getLLVMReg(Inst.getOperand(2).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
       EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
       EXCEPT(uint16_t ValB = State.getReg(RegSrcB) & 0xf);
       uint16_t Res = ValA >> ValB;
@@ -451,15 +532,75 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // LSRI
     case AAP::LSRI_i6:
     case AAP::LSRI_i3_short: {
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegSrcA = getLLVMReg(Inst.getOperand(1).getReg());
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
       EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
-      EXCEPT(uint16_t ValB = Inst.getOperand(2).getImm() & 0xf);
+      EXCEPT(uint16_t ValB = Inst.Imm & 0xf);
       uint16_t Res = ValA >> ValB;
       EXCEPT(State.setReg(RegDst, Res));
       break;
     }
 
+    // Multiply, from the optional multiply and divide unit
+    case AAP::MUL_r:
+    case AAP::MULHS_r:
+    case AAP::MULHU_r: {
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
+      EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
+      EXCEPT(uint16_t ValB = State.getReg(RegSrcB));
+      uint32_t Res;
+      if (Inst.Opcode == AAP::MULHS_r)
+        Res = static_cast<uint32_t>(static_cast<int32_t>(int16_t(ValA)) *
+                                    static_cast<int32_t>(int16_t(ValB))) >>
+              16;
+      else if (Inst.Opcode == AAP::MULHU_r)
+        Res = (static_cast<uint32_t>(ValA) * ValB) >> 16;
+      else
+        Res = static_cast<uint32_t>(ValA) * ValB;
+      EXCEPT(State.setReg(RegDst, static_cast<uint16_t>(Res)));
+      break;
+    }
+
+    // Divide and remainder. Division by zero does not trap, the quotient is
+    // all ones and the remainder is the dividend. The signed overflow case
+    // gives a quotient of the dividend and a remainder of zero.
+    case AAP::DIVS_r:
+    case AAP::REMS_r: {
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
+      EXCEPT(int16_t ValA = static_cast<int16_t>(State.getReg(RegSrcA)));
+      EXCEPT(int16_t ValB = static_cast<int16_t>(State.getReg(RegSrcB)));
+      bool IsDiv = Inst.Opcode == AAP::DIVS_r;
+      int32_t Res;
+      if (ValB == 0)
+        Res = IsDiv ? -1 : ValA;
+      else if (ValA == -32768 && ValB == -1)
+        Res = IsDiv ? ValA : 0;
+      else
+        Res = IsDiv ? ValA / ValB : ValA % ValB;
+      EXCEPT(State.setReg(RegDst, static_cast<uint16_t>(Res)));
+      break;
+    }
+    case AAP::DIVU_r:
+    case AAP::REMU_r: {
+      int RegDst = Inst.Regs[0];
+      int RegSrcA = Inst.Regs[1];
+      int RegSrcB = Inst.Regs[2];
+      EXCEPT(uint16_t ValA = State.getReg(RegSrcA));
+      EXCEPT(uint16_t ValB = State.getReg(RegSrcB));
+      bool IsDiv = Inst.Opcode == AAP::DIVU_r;
+      uint16_t Res;
+      if (ValB == 0)
+        Res = IsDiv ? 0xffff : ValA;
+      else
+        Res = IsDiv ? ValA / ValB : ValA % ValB;
+      EXCEPT(State.setReg(RegDst, Res));
+      break;
+    }
+
     // Load
     case AAP::LDB:
     case AAP::LDB_short:
@@ -473,24 +614,24 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     case AAP::LDB_predec_short:
     case AAP::LDW_predec:
     case AAP::LDW_predec_short: {
-      bool postinc = (Inst.getOpcode() == AAP::LDB_postinc ||
-                      Inst.getOpcode() == AAP::LDB_postinc_short ||
-                      Inst.getOpcode() == AAP::LDW_postinc ||
-                      Inst.getOpcode() == AAP::LDW_postinc_short) ? true : false;
-      bool predec  = (Inst.getOpcode() == AAP::LDB_predec ||
-                      Inst.getOpcode() == AAP::LDB_predec_short ||
-                      Inst.getOpcode() == AAP::LDW_predec ||
-                      Inst.getOpcode() == AAP::LDW_predec_short) ? true : false;
-      bool word = (Inst.getOpcode() == AAP::LDW ||
-                   Inst.getOpcode() == AAP::LDW_short ||
-                   Inst.getOpcode() == AAP::LDW_postinc ||
-                   Inst.getOpcode() == AAP::LDW_postinc_short ||
-                   Inst.getOpcode() == AAP::LDW_predec ||
-                   Inst.getOpcode() == AAP::LDW_predec_short) ? true : false;
+      bool postinc = (Inst.Opcode == AAP::LDB_postinc ||
+                      Inst.Opcode == AAP::LDB_postinc_short ||
+                      Inst.Opcode == AAP::LDW_postinc ||
+                      Inst.Opcode == AAP::LDW_postinc_short) ? true : false;
+      bool predec  = (Inst.Opcode == AAP::LDB_predec ||
+                      Inst.Opcode == AAP::LDB_predec_short ||
+                      Inst.Opcode == AAP::LDW_predec ||
+                      Inst.Opcode == AAP::LDW_predec_short) ? true : false;
+      bool word = (Inst.Opcode == AAP::LDW ||
+                   Inst.Opcode == AAP::LDW_short ||
+                   Inst.Opcode == AAP::LDW_postinc ||
+                   Inst.Opcode == AAP::LDW_postinc_short ||
+                   Inst.Opcode == AAP::LDW_predec ||
+                   Inst.Opcode == AAP::LDW_predec_short) ? true : false;
       // Initial register values
-      int RegDst = getLLVMReg(Inst.getOperand(0).getReg());
-      int RegMem = getLLVMReg(Inst.getOperand(1).getReg());
-      int Offset = Inst.getOperand(2).getImm();
+      int RegDst = Inst.Regs[0];
+      int RegMem = Inst.Regs[1];
+      int Offset = Inst.Imm;
       EXCEPT(uint16_t BaseAddress = State.getReg(RegMem));
       // Handle pre-dec
       if (predec) {
@@ -528,24 +669,24 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     case AAP::STB_predec_short:
     case AAP::STW_predec:
     case AAP::STW_predec_short: {
-      bool postinc = (Inst.getOpcode() == AAP::STB_postinc ||
-                      Inst.getOpcode() == AAP::STB_postinc_short ||
-                      Inst.getOpcode() == AAP::STW_postinc ||
-                      Inst.getOpcode() == AAP::STW_postinc_short) ? true : false;
-      bool predec  = (Inst.getOpcode() == AAP::STB_predec ||
-                      Inst.getOpcode() == AAP::STB_predec_short ||
-                      Inst.getOpcode() == AAP::STW_predec ||
-                      Inst.getOpcode() == AAP::STW_predec_short) ? true : false;
-      bool word = (Inst.getOpcode() == AAP::STW ||
-                   Inst.getOpcode() == AAP::STW_short ||
-                   Inst.getOpcode() == AAP::STW_postinc ||
-                   Inst.getOpcode() == AAP::STW_postinc_short ||
-                   Inst.getOpcode() == AAP::STW_predec ||
-                   Inst.getOpcode() == AAP::STW_predec_short) ? true : false;
+      bool postinc = (Inst.Opcode == AAP::STB_postinc ||
+                      Inst.Opcode == AAP::STB_postinc_short ||
+                      Inst.Opcode == AAP::STW_postinc ||
+                      Inst.Opcode == AAP::STW_postinc_short) ? true : false;
+      bool predec  = (Inst.Opcode == AAP::STB_predec ||
+                      Inst.Opcode == AAP::STB_predec_short ||
+                      Inst.Opcode == AAP::STW_predec ||
+                      Inst.Opcode == AAP::STW_predec_short) ? true : false;
+      bool word = (Inst.Opcode == AAP::STW ||
+                   Inst.Opcode == AAP::STW_short ||
+                   Inst.Opcode == AAP::STW_postinc ||
+                   Inst.Opcode == AAP::STW_postinc_short ||
+                   Inst.Opcode == AAP::STW_predec ||
+                   Inst.Opcode == AAP::STW_predec_short) ? true : false;
       // Initial register values
-      int RegMem = getLLVMReg(Inst.getOperand(0).getReg());
-      int Offset = Inst.getOperand(1).getImm();
-      int RegSrc = getLLVMReg(Inst.getOperand(2).getReg());
+      int RegMem = Inst.Regs[0];
+      int Offset = Inst.Imm;
+      int RegSrc = Inst.Regs[1];
       EXCEPT(uint16_t BaseAddress = State.getReg(RegMem));
       EXCEPT(uint16_t Val = State.getReg(RegSrc));
       // Handle pre-dec
@@ -573,22 +714,18 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     // Branch and Link
     case AAP::BAL:
     case AAP::BAL_short: {
-      int Reg = getLLVMReg(Inst.getOperand(1).getReg());
+      int Reg = Inst.Regs[0];
       EXCEPT(State.setReg(Reg, newpc_w));
-      uint16_t Imm = Inst.getOperand(0).getImm();
-      int16_t SImm =
-          (Inst.getOpcode() == AAP::BAL) ? static_cast<int16_t>(Imm) :
-                                           signExtendBranchAndLinkS(Imm);
-      newpc_w = pc_w + SImm;
+      newpc_w = pc_w + Inst.Imm;
       break;
     }
 
     // Jump and Link
     case AAP::JAL:
     case AAP::JAL_short: {
-      int Reg = getLLVMReg(Inst.getOperand(1).getReg());
+      int Reg = Inst.Regs[1];
       EXCEPT(State.setReg(Reg, newpc_w));
-      EXCEPT(newpc_w = State.getReg(getLLVMReg(Inst.getOperand(0).getReg())));
+      EXCEPT(newpc_w = State.getReg(Inst.Regs[0]));
       break;
     }
 
@@ -605,54 +742,41 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
     case AAP::BLTU_short:
     case AAP::BLEU_:
     case AAP::BLEU_short: {
-      uint16_t Imm = Inst.getOperand(0).getImm();
-      EXCEPT(uint16_t ValA = State.getReg(getLLVMReg(Inst.getOperand(1).getReg())));
+      EXCEPT(uint16_t ValA = State.getReg(Inst.Regs[0]));
       int16_t SValA = static_cast<int16_t>(ValA);
-      EXCEPT(uint16_t ValB = State.getReg(getLLVMReg(Inst.getOperand(2).getReg())));
+      EXCEPT(uint16_t ValB = State.getReg(Inst.Regs[1]));
       int16_t SValB = static_cast<int16_t>(ValB);
-      bool longbr = (Inst.getOpcode() == AAP::BEQ_ ||
-                     Inst.getOpcode() == AAP::BNE_ ||
-                     Inst.getOpcode() == AAP::BLTS_ ||
-                     Inst.getOpcode() == AAP::BLES_ ||
-                     Inst.getOpcode() == AAP::BLTU_ ||
-                     Inst.getOpcode() == AAP::BLEU_) ? true : false;
-      int16_t SImm = longbr ? signExtendBranchCC(Imm)
-                            : signExtendBranchCCS(Imm);
       bool branch = false;
       // Decide whether to branch based on instruction type
-      if (Inst.getOpcode() == AAP::BEQ_ || Inst.getOpcode() == AAP::BEQ_short)
+      if (Inst.Opcode == AAP::BEQ_ || Inst.Opcode == AAP::BEQ_short)
         branch = (ValA == ValB) ? true : false;
-      if (Inst.getOpcode() == AAP::BNE_ || Inst.getOpcode() == AAP::BNE_short)
+      if (Inst.Opcode == AAP::BNE_ || Inst.Opcode == AAP::BNE_short)
         branch = (ValA != ValB) ? true : false;
-      if (Inst.getOpcode() == AAP::BLTS_ || Inst.getOpcode() == AAP::BLTS_short)
+      if (Inst.Opcode == AAP::BLTS_ || Inst.Opcode == AAP::BLTS_short)
         branch = (SValA < SValB) ? true : false;
-      if (Inst.getOpcode() == AAP::BLES_ || Inst.getOpcode() == AAP::BLES_short)
+      if (Inst.Opcode == AAP::BLES_ || Inst.Opcode == AAP::BLES_short)
         branch = (SValA <= SValB) ? true : false;
-      if (Inst.getOpcode() == AAP::BLTU_ || Inst.getOpcode() == AAP::BLTU_short)
+      if (Inst.Opcode == AAP::BLTU_ || Inst.Opcode == AAP::BLTU_short)
         branch = (ValA < ValB) ? true : false;
-      if (Inst.getOpcode() == AAP::BLEU_ || Inst.getOpcode() == AAP::BLEU_short)
+      if (Inst.Opcode == AAP::BLEU_ || Inst.Opcode == AAP::BLEU_short)
         branch = (ValA <= ValB) ? true : false;
       // Branch if needed
       if (branch)
-        newpc_w = pc_w + SImm;
+        newpc_w = pc_w + Inst.Imm;
       break;
     }
 
     // Branch
     case AAP::BRA:
     case AAP::BRA_short: {
-      uint32_t Offset = Inst.getOperand(0).getImm();
-      int32_t SOffset = 
-          (Inst.getOpcode() == AAP::BRA) ? signExtendBranch(Offset)
-                                         : signExtendBranchS(Offset);
-      newpc_w = pc_w + SOffset;
+      newpc_w = pc_w + Inst.Imm;
       break;
     }
 
     // Jump
     case AAP::JMP:
     case AAP::JMP_short: {
-      int Reg = getLLVMReg(Inst.getOperand(0).getReg());
+      int Reg = Inst.Regs[0];
       EXCEPT(newpc_w = State.getReg(Reg));
       break;
     }
@@ -662,36 +786,104 @@ SimStatus AAPSimulator::exec(MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w) {
   return SimStatus::SIM_OK;
 }
 
-SimStatus AAPSimulator::step() {
+const AAPDecodedInst *AAPSimulator::decode(uint32_t pc_w) {
+  const AAPDecodedInst *Cached = DecodeCache.lookup(pc_w);
+  if (Cached)
+    return Cached;
+
   MCInst Inst;
   uint64_t Size;
-  uint32_t pc_w = State.getPC();
   ArrayRef<uint8_t> *Bytes = State.getCodeArray();
+  if (!DisAsm->getInstruction(Inst, Size, Bytes->slice(pc_w << 1),
+                              (pc_w << 1), nulls(), nulls()))
+    return nullptr;
 
-  // Reset any previous exception state
-  State.resetStatus();
+  AAPDecodedInst Decoded;
+  decodeInst(Inst, Size, Decoded);
+  return DecodeCache.insert(pc_w, Decoded);
+}
 
-  if (DisAsm->getInstruction(Inst, Size, Bytes->slice(pc_w << 1), (pc_w << 1),
-                             nulls(), nulls())) {
-    if (Trace) {
-      // Instruction decoded, execute it and write back our PC
-      dbgs() << format("%06" PRIx64 ":", pc_w);
-      IP->printInst(&Inst, dbgs(), "", *STI);
-      dbgs() << "\n";
-    }
+void AAPSimulator::printInst(uint32_t pc_w) {
+  MCInst Inst;
+  uint64_t Size;
+  ArrayRef<uint8_t> *Bytes = State.getCodeArray();
+  dbgs() << format("%06" PRIx64 ":", pc_w);
+  if (DisAsm->getInstruction(Inst, Size, Bytes->slice(pc_w << 1),
+                             (pc_w << 1), nulls(), nulls()))
+    IP->printInst(&Inst, dbgs(), "", *STI);
+  dbgs() << "\n";
+}
 
-    uint32_t newpc_w = pc_w + (Size >> 1);
-    SimStatus status;
-    status = exec(Inst, pc_w, newpc_w);
-    State.setPC(newpc_w);
+SimStatus AAPSimulator::step() {
+  uint32_t pc_w = State.getPC();
 
-    return status;
-  }
-  else {
+  // Reset any previous exception state
+  State.resetStatus();
+
+  const AAPDecodedInst *Inst = decode(pc_w);
+  if (!Inst) {
     // Unable to read/decode an instruction. If the memory system threw an
     // exception, pass this on, otherwise return invalid instruction.
     if (State.getStatus() != SimStatus::SIM_OK)
-      return SimStatus::SIM_INVALID_INSN;
+      return State.getStatus();
+    return SimStatus::SIM_INVALID_INSN;
+  }
+
+  // Instruction decoded, execute it and write back our PC
+  if (Trace)
+    printInst(pc_w);
+
+  uint32_t newpc_w = pc_w + Inst->Size;
+  SimStatus status;
+  status = exec(*Inst, pc_w, newpc_w);
+  State.setPC(newpc_w);
+
+  Stats.addInst(*Inst, pc_w);
+  if (AAPSimStats::isCall(Inst->Opcode))
+    Stats.addCall(pc_w, newpc_w);
+  switch (AAPSimStats::getBranchKind(Inst->Opcode)) {
+  case AAPSimStats::NotBranch:
+    break;
+  case AAPSimStats::CondBranch:
+    if (newpc_w != pc_w + Inst->Size)
+      Stats.addBranches(1, 0);
+    else
+      Stats.addBranches(0, 1);
+    break;
+  case AAPSimStats::UncondBranch:
+    Stats.addBranches(1, 0);
+    break;
+  }
+
+  // Report branches outside of the code space
+  if (status == SimStatus::SIM_OK && State.getStatus() != SimStatus::SIM_OK)
     return State.getStatus();
+  return status;
+}
+
+const AAPSimStats &AAPSimulator::getStats() {
+  BlockEngine.collectStats();
+  return Stats;
+}
+
+SimStatus AAPSimulator::run(uint64_t MaxInsts) {
+  uint64_t Retired = 0;
+
+  // Instruction tracing and state observers are only supported by the
+  // interpreter
+  if (Engine == SimEngine::Block && !Trace && !State.getObserver()) {
+    SimStatus status = BlockEngine.run(MaxInsts, Retired);
+    if (status != SimStatus::SIM_OK)
+      return status;
+  }
+
+  // Interpret whatever remains. For the block engine, this is the end of
+  // the budget which was too small for a whole block.
+  SimStatus status = SimStatus::SIM_OK;
+  for (; Retired < MaxInsts && status == SimStatus::SIM_OK; ++Retired) {
+    if (isStopRequested())
+      return SimStatus::SIM_TIMEOUT;
+    status = step();
   }
+  return status;
 }
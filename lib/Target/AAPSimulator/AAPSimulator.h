@@ -20,13 +20,40 @@
 #include "llvm/MC/MCRegisterInfo.h"
 #include "llvm/MC/MCSubtargetInfo.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "AAPBlockEngine.h"
+#include "AAPDecodeCache.h"
 #include "AAPSimState.h"
+#include "AAPSimStats.h"
+#include <atomic>
+
+namespace llvm {
+class MCContext;
+class MCObjectFileInfo;
+}
 
 namespace AAPSim {
 
+/// Register the parts of the AAP target used by the simulator: its target
+/// info, MC layer and disassembler. This is called by the AAPSimulator
+/// constructor, and may be called any number of times.
+void initialize();
+
+/// SimEngine - the execution engine used by AAPSimulator::run
+enum class SimEngine {
+  Interpreter,  // Decode and execute one instruction at a time
+  Block         // Translate and execute basic blocks
+};
+
 /// AAPSimulator - AAP Simulator
 class AAPSimulator {
   AAPSimState State;
+  AAPDecodeCache DecodeCache;
+  AAPSimStats Stats;
+  AAPBlockEngine BlockEngine;
+  SimEngine Engine;
+
+  // Set from any thread to stop a running simulation
+  std::atomic<bool> StopRequested;
 
   // Target/MCInfo
   const llvm::Target *TheTarget;
@@ -34,27 +61,83 @@ class AAPSimulator {
   const llvm::MCAsmInfo *AsmInfo;
   const llvm::MCSubtargetInfo *STI;
   const llvm::MCInstrInfo *MII;
+  const llvm::MCObjectFileInfo *MOFI;
+  llvm::MCContext *Ctx;
   llvm::MCDisassembler *DisAsm;
   llvm::MCInstPrinter *IP;
 
+  // Streams written to by the simulated program
+  llvm::raw_ostream *Out;
+  llvm::raw_ostream *Err;
+
+  /// Print the instruction at pc_w for tracing
+  void printInst(uint32_t pc_w);
+
 public:
   AAPSimulator();
 
   AAPSimState &getState() { return State; }
 
-  /// Functions for writing bulk to the code/data memories
-  void WriteCodeSection(llvm::StringRef Bytes, uint32_t address);
-  void WriteDataSection(llvm::StringRef Bytes, uint32_t address);
+  /// Return the processor, memories and statistics to their initial state,
+  /// so that another program can be loaded.
+  void reset();
+
+  /// Save the processor state and written memory to a snapshot, and restore
+  /// it, replacing the current state
+  void saveSnapshot(llvm::raw_ostream &OS) const { State.saveSnapshot(OS); }
+  llvm::Error restoreSnapshot(llvm::StringRef Snapshot);
+
+  /// Redirect the output of the simulated program, which defaults to
+  /// stdout and stderr.
+  void setOutput(llvm::raw_ostream &OutStream, llvm::raw_ostream &ErrStream) {
+    Out = &OutStream;
+    Err = &ErrStream;
+  }
+  const llvm::MCInstrInfo &getInstrInfo() const { return *MII; }
+
+  /// Statistics about the instructions executed so far
+  const AAPSimStats &getStats();
+
+  /// Enable collection of per instruction and call edge counts
+  void setProfiling(bool enabled) { Stats.Profiling = enabled; }
+
+  /// Functions for writing bulk to the code/data memories. If the bytes come
+  /// from a file, FD and FileOffset locate them so that they can be mapped
+  /// copy-on-write rather than copied. Returns false if the bytes do not fit.
+  bool WriteCodeSection(llvm::StringRef Bytes, uint32_t address, int FD = -1,
+                        uint64_t FileOffset = 0);
+  bool WriteDataSection(llvm::StringRef Bytes, uint32_t address, int FD = -1,
+                        uint64_t FileOffset = 0);
 
   /// Set Program Counter
   void setPC(uint32_t pc_w) { State.setPC(pc_w); }
 
+  /// Decode the instruction at pc_w, returning nullptr if it is invalid.
+  /// Decoded instructions are cached until the code memory they were
+  /// decoded from is written to.
+  const AAPDecodedInst *decode(uint32_t pc_w);
+
   /// Execute an instruction
-  SimStatus exec(llvm::MCInst &Inst, uint32_t pc_w, uint32_t &newpc_w);
+  SimStatus exec(const AAPDecodedInst &Inst, uint32_t pc_w, uint32_t &newpc_w);
 
   /// Step the processor
   SimStatus step();
 
+  /// Run the processor until a non-OK status is raised or exactly MaxInsts
+  /// instructions have been executed. Returns SIM_TIMEOUT if requestStop is
+  /// called while running.
+  SimStatus run(uint64_t MaxInsts);
+
+  /// Ask a running simulation to stop. This may be called from any thread.
+  void requestStop() { StopRequested.store(true, std::memory_order_relaxed); }
+  bool isStopRequested() const {
+    return StopRequested.load(std::memory_order_relaxed);
+  }
+
+  /// Select the engine used by run
+  SimEngine getEngine() const { return Engine; }
+  void setEngine(SimEngine E) { Engine = E; }
+
   /// Trace control
   bool getTracing() const { return State.getTracing(); }
   void setTracing(bool enabled) { State.setTracing(enabled); }
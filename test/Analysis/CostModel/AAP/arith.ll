@@ -0,0 +1,54 @@
+; RUN: opt < %s -cost-model -analyze -mtriple=aap | FileCheck %s --check-prefixes=CHECK,SOFT
+; RUN: opt < %s -cost-model -analyze -mtriple=aap -mattr=+muldiv | FileCheck %s --check-prefixes=CHECK,HARD
+
+define void @add(i16 %a, i16 %b, i32 %c, i32 %d) {
+; CHECK-LABEL: add
+; CHECK: cost of 1 {{.*}} add i16
+; CHECK: cost of 3 {{.*}} add i32
+; CHECK: cost of 3 {{.*}} sub i32
+  %1 = add i16 %a, %b
+  %2 = add i32 %c, %d
+  %3 = sub i32 %c, %d
+  ret void
+}
+
+define void @shift(i16 %a, i16 %b, i32 %c, i32 %d) {
+; CHECK-LABEL: shift
+; CHECK: cost of 1 {{.*}} shl i16
+; CHECK: cost of 6 {{.*}} shl i32 %c, 3
+; CHECK: cost of 16 {{.*}} lshr i32 %c, %d
+  %1 = shl i16 %a, %b
+  %2 = shl i32 %c, 3
+  %3 = lshr i32 %c, %d
+  ret void
+}
+
+define void @mul(i16 %a, i16 %b, i32 %c, i32 %d) {
+; CHECK-LABEL: mul
+; SOFT: cost of 16 {{.*}} mul i16 %a, %b
+; HARD: cost of 2 {{.*}} mul i16 %a, %b
+; SOFT: cost of 4 {{.*}} mul i16 %a, 10
+; HARD: cost of 2 {{.*}} mul i16 %a, 10
+; CHECK: cost of 1 {{.*}} mul i16 %a, 8
+; CHECK: cost of 32 {{.*}} mul i32
+  %1 = mul i16 %a, %b
+  %2 = mul i16 %a, 10
+  %3 = mul i16 %a, 8
+  %4 = mul i32 %c, %d
+  ret void
+}
+
+define void @div(i16 %a, i16 %b, i32 %c, i32 %d) {
+; CHECK-LABEL: div
+; SOFT: cost of 40 {{.*}} udiv i16 %a, %b
+; HARD: cost of 16 {{.*}} udiv i16 %a, %b
+; SOFT: cost of 40 {{.*}} srem i16 %a, %b
+; HARD: cost of 16 {{.*}} srem i16 %a, %b
+; CHECK: cost of 1 {{.*}} udiv i16 %a, 8
+; CHECK: cost of 80 {{.*}} sdiv i32
+  %1 = udiv i16 %a, %b
+  %2 = srem i16 %a, %b
+  %3 = udiv i16 %a, 8
+  %4 = sdiv i32 %c, %d
+  ret void
+}
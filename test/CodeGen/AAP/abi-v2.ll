@@ -0,0 +1,84 @@
+; RUN: llc -asm-show-inst -march=aap -mattr=+abi-v2 < %s | FileCheck %s
+
+
+; Check the revised ABI, where argument registers are caller-saved, i32
+; values and small aggregates are passed in consecutive registers, and
+; registers from R8 upwards are callee-saved.
+
+
+declare void @use(i16)
+declare i16 @get()
+
+
+; Argument registers are not saved and restored by the callee
+
+define i16 @no_arg_saves(i16 %a) {
+entry:
+;CHECK: no_arg_saves:
+;CHECK-NOT: stw {{.*}}, $r{{[2-7] }}
+;CHECK: bal use
+;CHECK-NOT: ldw $r{{[2-7]}}, [$r1
+  call void @use(i16 %a)
+  ret i16 %a ;CHECK: jmp   {{.*JMP}}
+}
+
+; A value live across a call is kept in a callee-saved high register
+
+define i16 @live_across_call(i16 %a) {
+entry:
+;CHECK: live_across_call:
+;CHECK: stw {{.*}}, $r{{([89]|[1-9][0-9]) }}
+;CHECK: bal get
+;CHECK: ldw $r{{([89]|[1-9][0-9])}}, [$r1
+  %b = call i16 @get()
+  %c = add i16 %a, %b
+  ret i16 %c ;CHECK: jmp   {{.*JMP}}
+}
+
+
+; An i32 argument is passed in a register pair
+
+define i16 @i32_pair(i16 %a, i32 %b) {
+entry:
+;CHECK: i32_pair:
+;CHECK: add $r2, $r3, $r2                        {{.*ADD_r}}
+  %lo = trunc i32 %b to i16
+  %r = add i16 %lo, %a
+  ret i16 %r ;CHECK: jmp   {{.*JMP}}
+}
+
+; An i32 argument which does not fit in the remaining registers is passed
+; entirely on the stack
+
+define i16 @i32_stack(i16 %a, i16 %b, i16 %c, i16 %d, i16 %e, i32 %f) {
+entry:
+;CHECK: i32_stack:
+;CHECK: ldw $r{{[0-9]+}}, [$r1, 2]               {{.*LDW}}
+  %hi32 = lshr i32 %f, 16
+  %hi = trunc i32 %hi32 to i16
+  ret i16 %hi ;CHECK: jmp   {{.*JMP}}
+}
+
+define void @call_i32_stack() {
+entry:
+;CHECK: call_i32_stack:
+;CHECK-DAG: stw [$r1, 2], $[[HALF:r[0-9]+]]       {{.*STW}}
+;CHECK-DAG: stw [$r1, 0], $[[HALF]]               {{.*STW}}
+;CHECK-DAG: movi $r6, 5                           {{.*MOVI}}
+;CHECK: bal i32_stack
+  %r = call i16 @i32_stack(i16 1, i16 2, i16 3, i16 4, i16 5, i32 65537)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+
+; Small aggregates are passed in consecutive registers
+
+define i16 @struct_pair({ i16, i16 } %s) {
+entry:
+;CHECK: struct_pair:
+;CHECK: add $r2, $r2, $r3                        {{.*ADD_r}}
+  %a = extractvalue { i16, i16 } %s, 0
+  %b = extractvalue { i16, i16 } %s, 1
+  %r = add i16 %a, %b
+  ret i16 %r ;CHECK: jmp   {{.*JMP}}
+}
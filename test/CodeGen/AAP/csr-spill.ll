@@ -0,0 +1,62 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s
+
+
+; Check that callee saved registers are pushed and popped with pre-decrement
+; stores and post-increment loads, and that registers in GR8 use the short
+; forms
+
+
+declare void @use(i16)
+declare i16 @get()
+
+
+; The link register is pushed before the call, and popped in the reverse
+; order to the push
+
+define void @save_link() {
+entry:
+;CHECK: save_link:
+;CHECK: stw [-$r1, 2], $r0                       {{.*STW_predec_short}}
+;CHECK: bal get
+;CHECK: ldw $r0, [$r1+, 2]                       {{.*LDW_postinc_short}}
+;CHECK: jmp   {{.*JMP}}
+  %a = call i16 @get()
+  call void @use(i16 %a)
+  ret void
+}
+
+; Locals are allocated after the pushes, and freed before the pops
+
+define void @save_with_local() {
+entry:
+;CHECK: save_with_local:
+;CHECK: stw [-$r1, 2], $r0                       {{.*STW_predec_short}}
+;CHECK: subi $r1, $r1, {{[0-9]+}}                {{.*SUBI}}
+;CHECK: bal use
+;CHECK: addi $r1, $r1, {{[0-9]+}}                {{.*ADDI}}
+;CHECK: ldw $r0, [$r1+, 2]                       {{.*LDW_postinc_short}}
+;CHECK: jmp   {{.*JMP}}
+  %local = alloca i16
+  %v = load volatile i16, i16* %local
+  call void @use(i16 %v)
+  ret void
+}
+
+; With a frame pointer the stack pointer is reset to just below the pushes
+
+define void @save_with_fp() #0 {
+entry:
+;CHECK: save_with_fp:
+;CHECK: stw [-$r1, 2], $r8                       {{.*STW_predec}}
+;CHECK: addi $r8, $r1, 2                         {{.*ADDI_i10}}
+;CHECK: stw [-$r1, 2], $r0                       {{.*STW_predec_short}}
+;CHECK: bal get
+;CHECK: subi $r1, $r8, 6                         {{.*SUBI_i10}}
+;CHECK: ldw $r0, [$r1+, 2]                       {{.*LDW_postinc_short}}
+;CHECK: ldw $r8, [$r1+, 2]                       {{.*LDW_postinc}}
+  %a = call i16 @get()
+  call void @use(i16 %a)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+attributes #0 = { "no-frame-pointer-elim"="true" }
@@ -0,0 +1,138 @@
+; RUN: llc -O0 -asm-show-inst -march=aap -fast-isel-abort=3 < %s | FileCheck %s
+
+
+; Check that FastISel selects common operations at -O0 without falling back
+; to SelectionDAG
+
+
+declare i16 @callee(i16, i16)
+
+%struct.pair = type { i16, i16, i16 }
+
+@g = global %struct.pair zeroinitializer
+
+
+define i16 @alu(i16 %a, i16 %b) {
+entry:
+;CHECK-LABEL: alu:
+;CHECK: add $r{{[0-9]+}}, $r{{[0-9]+}}, $r{{[0-9]+}} {{.*ADD_r}}
+;CHECK: addi $r{{[0-9]+}}, $r{{[0-9]+}}, 5 {{.*ADDI}}
+;CHECK: xor $r{{[0-9]+}}, $r{{[0-9]+}}, $r{{[0-9]+}} {{.*XOR_r}}
+;CHECK: lsli $r{{[0-9]+}}, $r{{[0-9]+}}, 3 {{.*LSLI}}
+  %s1 = add i16 %a, %b
+  %s2 = add i16 %s1, 5
+  %s3 = xor i16 %s2, %a
+  %s4 = shl i16 %s3, 3
+  ret i16 %s4 ;CHECK: jmp $r0
+}
+
+; Constant offsets from a base are folded into the load or store
+
+define i16 @load_store_offset(%struct.pair* %p) {
+entry:
+;CHECK-LABEL: load_store_offset:
+;CHECK: ldw $r{{[0-9]+}}, [$r{{[0-9]+}}, 4] {{.*LDW}}
+;CHECK: stw [$r{{[0-9]+}}, 2], $r{{[0-9]+}} {{.*STW}}
+  %f2 = getelementptr %struct.pair, %struct.pair* %p, i16 0, i32 2
+  %v = load i16, i16* %f2
+  %f1 = getelementptr %struct.pair, %struct.pair* %p, i16 0, i32 1
+  store i16 %v, i16* %f1
+  ret i16 %v
+}
+
+define void @store_global_byte(i8 %v) {
+entry:
+;CHECK-LABEL: store_global_byte:
+;CHECK: movi $r{{[0-9]+}}, g {{.*MOVI_i16}}
+;CHECK: stb [$r{{[0-9]+}}, 4], $r{{[0-9]+}} {{.*STB}}
+  %p = bitcast i16* getelementptr (%struct.pair, %struct.pair* @g, i16 0, i32 2) to i8*
+  store i8 %v, i8* %p
+  ret void
+}
+
+; Calls pass arguments in registers and return the result in R2
+
+define i16 @direct_call(i16 %a) {
+entry:
+;CHECK-LABEL: direct_call:
+;CHECK: bal callee, $r0 {{.*BAL}}
+  %r = call i16 @callee(i16 %a, i16 7)
+  %s = add i16 %r, 1
+  ret i16 %s
+}
+
+define i16 @indirect_call(i16 (i16, i16)* %f, i16 %a) {
+entry:
+;CHECK-LABEL: indirect_call:
+;CHECK: jal $r{{[0-9]+}}, $r0 {{.*JAL}}
+  %r = call i16 %f(i16 %a, i16 %a)
+  ret i16 %r
+}
+
+; Comparisons feeding a branch are folded into it, with the operands swapped
+; for conditions without a direct equivalent
+
+define i16 @branch(i16 %a, i16 %b) {
+entry:
+;CHECK-LABEL: branch:
+;CHECK: blts {{.*}}, $r{{[0-9]+}}, $r{{[0-9]+}} {{.*BLTS}}
+  %c = icmp sgt i16 %a, %b
+  br i1 %c, label %then, label %else
+then:
+  ret i16 %a
+else:
+  ret i16 %b
+}
+
+; Comparisons producing a value use the borrow flag
+
+define i16 @compare(i16 %a, i16 %b) {
+entry:
+;CHECK-LABEL: compare:
+;CHECK: sub $r{{[0-9]+}}, $r{{[0-9]+}}, $r{{[0-9]+}} {{.*SUB_r}}
+;CHECK: subc $r{{[0-9]+}}, $r{{[0-9]+}}, $r{{[0-9]+}} {{.*SUBC_r}}
+;CHECK: andi $r{{[0-9]+}}, $r{{[0-9]+}}, 1 {{.*ANDI_i9}}
+;CHECK-NOT: andi
+;CHECK: jmp
+  %c = icmp ult i16 %a, %b
+  %z = zext i1 %c to i16
+  ret i16 %z
+}
+
+; The zero extension is the only mask of the borrow
+
+define i16 @compare_eq(i16 %a, i16 %b) {
+entry:
+;CHECK-LABEL: compare_eq:
+;CHECK: xor $r{{[0-9]+}}, $r{{[0-9]+}}, $r{{[0-9]+}} {{.*XOR_r}}
+;CHECK: subi $r{{[0-9]+}}, $r{{[0-9]+}}, 1 {{.*SUBI}}
+;CHECK: subc $r{{[0-9]+}}, $r{{[0-9]+}}, $r{{[0-9]+}} {{.*SUBC_r}}
+;CHECK: andi $r{{[0-9]+}}, $r{{[0-9]+}}, 1 {{.*ANDI_i9}}
+;CHECK-NOT: andi
+;CHECK: jmp
+  %c = icmp eq i16 %a, %b
+  %z = zext i1 %c to i16
+  ret i16 %z
+}
+
+define i16 @extend(i8 %a) {
+entry:
+;CHECK-LABEL: extend:
+;CHECK: lsli $r{{[0-9]+}}, $r{{[0-9]+}}, 8 {{.*LSLI}}
+;CHECK: asri $r{{[0-9]+}}, $r{{[0-9]+}}, 8 {{.*ASRI}}
+  %s = sext i8 %a to i16
+  ret i16 %s
+}
+
+; Locals are accessed through their frame index
+
+define i16 @local() {
+entry:
+;CHECK-LABEL: local:
+;CHECK: stw [$r1, {{[0-9]+}}], $r{{[0-9]+}} {{.*STW}}
+;CHECK: ldw $r{{[0-9]+}}, [$r1, {{[0-9]+}}] {{.*LDW}}
+  %x = alloca i16
+  store volatile i16 3, i16* %x
+  %v = load volatile i16, i16* %x
+  ret i16 %v
+}
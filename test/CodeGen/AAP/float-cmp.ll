@@ -11,11 +11,10 @@ entry:
 ;CHECK:     float_eq:
 ;CHECK:       bal __eqsf2
 ;CHECK-NOT:   or $r2, $r3
-;CHECK:       mov $[[RES:r[0-9]+]], $r2
-;CHECK:       movi $r2, 1
-;CHECK:       beq .LBB0_2, $[[RES]], ${{r[0-9]+}}
-;CHECK:       movi $r2, 0
-;CHECK:     .LBB0_2:
+;CHECK-NOT:   beq
+;CHECK:       subi $[[RES:r[0-9]+]], $r2, 1
+;CHECK:       subc $[[MASK:r[0-9]+]], $[[RES]], $[[RES]]
+;CHECK:       andi $r2, $[[MASK]], 1
   %cmp = fcmp oeq float %a, %b
   %conv1 = zext i1 %cmp to i16
   ret i16 %conv1 ;CHECK: jmp {{.*JMP}}
@@ -26,11 +25,10 @@ entry:
 ;CHECK:     double_eq:
 ;CHECK:       bal __eqdf2
 ;CHECK-NOT:   or $r2, $r3
-;CHECK:       mov $[[RES:r[0-9]+]], $r2
-;CHECK:       movi $r2, 1
-;CHECK:       beq .LBB1_2, $[[RES]], ${{r[0-9]+}}
-;CHECK:       movi $r2, 0
-;CHECK:     .LBB1_2:
+;CHECK-NOT:   beq
+;CHECK:       subi $[[RES:r[0-9]+]], $r2, 1
+;CHECK:       subc $[[MASK:r[0-9]+]], $[[RES]], $[[RES]]
+;CHECK:       andi $r2, $[[MASK]], 1
   %cmp = fcmp oeq double %a, %b
   %conv1 = zext i1 %cmp to i16
   ret i16 %conv1 ;CHECK: jmp {{.*JMP}}
@@ -43,11 +41,8 @@ entry:
 ;CHECK:     float_lt:
 ;CHECK:       bal __ltsf2
 ;CHECK-NOT:   or $r2, $r3
-;CHECK:       mov $[[RES:r[0-9]+]], $r2
-;CHECK:       movi $r2, 1
-;CHECK:       blts .LBB2_2, $[[RES]], ${{r[0-9]+}}
-;CHECK:       movi $r2, 0
-;CHECK:     .LBB2_2:
+;CHECK-NOT:   blts
+;CHECK:       lsri $r2, $r2, 15
   %cmp = fcmp olt float %a, %b
   %conv1 = zext i1 %cmp to i16
   ret i16 %conv1 ;CHECK: jmp {{.*JMP}}
@@ -58,11 +53,8 @@ entry:
 ;CHECK:     double_lt:
 ;CHECK:       bal __ltdf2
 ;CHECK-NOT:   or $r2, $r3
-;CHECK:       mov $[[RES:r[0-9]+]], $r2
-;CHECK:       movi $r2, 1
-;CHECK:       blts .LBB3_2, $[[RES]], ${{r[0-9]+}}
-;CHECK:       movi $r2, 0
-;CHECK:     .LBB3_2:
+;CHECK-NOT:   blts
+;CHECK:       lsri $r2, $r2, 15
   %cmp = fcmp olt double %a, %b
   %conv1 = zext i1 %cmp to i16
   ret i16 %conv1 ;CHECK: jmp {{.*JMP}}
@@ -0,0 +1,71 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s
+
+
+; Check the frame pointer setup, and frame accesses relative to it
+
+
+declare void @use(i16*)
+declare i8* @llvm.frameaddress(i32)
+
+
+; Without a frame pointer, locals are addressed from the stack pointer
+
+define void @no_fp() {
+entry:
+;CHECK: no_fp:
+;CHECK-NOT: $r8
+;CHECK: subi $r1, $r1, {{[0-9]+}}                {{.*SUBI}}
+;CHECK: mov $r2, $r1                             {{.*MOV_r}}
+;CHECK: bal use
+;CHECK: addi $r1, $r1, {{[0-9]+}}                {{.*ADDI}}
+  %local = alloca i16
+  call void @use(i16* %local)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+; The frame pointer is set up when frame pointer elimination is disabled,
+; and locals are addressed from it
+
+define void @fp_forced() #0 {
+entry:
+;CHECK: fp_forced:
+;CHECK: stw [-$r1, 2], $r8                       {{.*STW_predec}}
+;CHECK: addi $r8, $r1, 2                         {{.*ADDI_i10}}
+;CHECK: subi $r2, $r8, {{[0-9]+}}                {{.*SUBI_i10}}
+;CHECK: bal use
+;CHECK: subi $r1, $r8, 6                         {{.*SUBI_i10}}
+;CHECK: ldw $r8, [$r1+, 2]                       {{.*LDW_postinc}}
+  %local = alloca i16
+  call void @use(i16* %local)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+; Variable sized objects are allocated by moving the stack pointer
+
+define void @dynamic_alloca(i16 %n) {
+entry:
+;CHECK: dynamic_alloca:
+;CHECK: stw [-$r1, 2], $r8                       {{.*STW_predec}}
+;CHECK: addi $r8, $r1, 2                         {{.*ADDI_i10}}
+;CHECK: sub $[[SP:r[0-9]+]], $r1, ${{r[0-9]+}}   {{.*SUB_r}}
+;CHECK: mov $r1, $[[SP]]                         {{.*MOV_r}}
+;CHECK: bal use
+;CHECK: subi $r1, $r8, 6                         {{.*SUBI_i10}}
+;CHECK: ldw $r8, [$r1+, 2]                       {{.*LDW_postinc}}
+  %buf = alloca i16, i16 %n
+  call void @use(i16* %buf)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+; The frame address is the value of the frame pointer
+
+define i8* @frame_address() {
+entry:
+;CHECK: frame_address:
+;CHECK: addi $r8, $r1, 2                         {{.*ADDI_i10}}
+;CHECK: mov $r2, $r8                             {{.*MOV_r}}
+  %fa = call i8* @llvm.frameaddress(i32 0)
+  ret i8* %fa ;CHECK: jmp   {{.*JMP}}
+}
+
+attributes #0 = { "no-frame-pointer-elim"="true" }
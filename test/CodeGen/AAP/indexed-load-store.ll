@@ -0,0 +1,133 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s
+
+
+; Check that pointer updates are folded into post-increment and
+; pre-decrement loads and stores
+
+
+; Post-increment loads and stores
+
+define i16 @ldw_postinc(i16** %pp) {
+entry:
+;CHECK: ldw_postinc:
+;CHECK: ldw ${{r[0-9]+}}, [$[[REG:r[0-9]+]]+, 2]   {{.*LDW_postinc}}
+;CHECK: stw [${{r[0-9]+}}, 0], $[[REG]]             {{.*STW}}
+  %p = load i16*, i16** %pp
+  %v = load i16, i16* %p
+  %next = getelementptr i16, i16* %p, i16 1
+  store i16* %next, i16** %pp
+  ret i16 %v ;CHECK: jmp   {{.*JMP}}
+}
+
+define i16 @ldb_postinc(i8** %pp) {
+entry:
+;CHECK: ldb_postinc:
+;CHECK: ldb ${{r[0-9]+}}, [$[[REG:r[0-9]+]]+, 1]   {{.*LDB_postinc}}
+;CHECK: stw [${{r[0-9]+}}, 0], $[[REG]]             {{.*STW}}
+  %p = load i8*, i8** %pp
+  %v = load i8, i8* %p
+  %next = getelementptr i8, i8* %p, i16 1
+  store i8* %next, i8** %pp
+  %ext = zext i8 %v to i16
+  ret i16 %ext ;CHECK: jmp   {{.*JMP}}
+}
+
+define void @stw_postinc(i16** %pp, i16 %v) {
+entry:
+;CHECK: stw_postinc:
+;CHECK: stw [$[[REG:r[0-9]+]]+, 2], ${{r[0-9]+}}   {{.*STW_postinc}}
+;CHECK: stw [${{r[0-9]+}}, 0], $[[REG]]             {{.*STW}}
+  %p = load i16*, i16** %pp
+  store i16 %v, i16* %p
+  %next = getelementptr i16, i16* %p, i16 1
+  store i16* %next, i16** %pp
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+define void @stb_postinc(i8** %pp, i16 %v) {
+entry:
+;CHECK: stb_postinc:
+;CHECK: stb [$[[REG:r[0-9]+]]+, 1], ${{r[0-9]+}}   {{.*STB_postinc}}
+;CHECK: stw [${{r[0-9]+}}, 0], $[[REG]]             {{.*STW}}
+  %p = load i8*, i8** %pp
+  %trunc = trunc i16 %v to i8
+  store i8 %trunc, i8* %p
+  %next = getelementptr i8, i8* %p, i16 1
+  store i8* %next, i8** %pp
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+
+; Pre-decrement loads and stores. Pre-increment accesses use a negative
+; decrement.
+
+define i16* @ldw_predec(i16* %p, i16* %out) {
+entry:
+;CHECK: ldw_predec:
+;CHECK: ldw ${{r[0-9]+}}, [-${{r[0-9]+}}, 2]        {{.*LDW_predec}}
+  %prev = getelementptr i16, i16* %p, i16 -1
+  %v = load i16, i16* %prev
+  store i16 %v, i16* %out
+  ret i16* %prev ;CHECK: jmp   {{.*JMP}}
+}
+
+define i16* @stw_predec(i16* %p, i16 %v) {
+entry:
+;CHECK: stw_predec:
+;CHECK: stw [-${{r[0-9]+}}, 2], ${{r[0-9]+}}        {{.*STW_predec}}
+  %prev = getelementptr i16, i16* %p, i16 -1
+  store i16 %v, i16* %prev
+  ret i16* %prev ;CHECK: jmp   {{.*JMP}}
+}
+
+define i16* @ldw_preinc(i16* %p, i16* %out) {
+entry:
+;CHECK: ldw_preinc:
+;CHECK: ldw ${{r[0-9]+}}, [-${{r[0-9]+}}, -2]       {{.*LDW_predec}}
+  %next = getelementptr i16, i16* %p, i16 1
+  %v = load i16, i16* %next
+  store i16 %v, i16* %out
+  ret i16* %next ;CHECK: jmp   {{.*JMP}}
+}
+
+
+; Offsets which do not fit in the instruction are not folded
+
+define i16 @ldw_postinc_large(i16** %pp) {
+entry:
+;CHECK: ldw_postinc_large:
+;CHECK-NOT: {{.*LDW_postinc}}
+;CHECK: ldw ${{r[0-9]+}}, [${{r[0-9]+}}, 0]         {{.*LDW}}
+  %p = load i16*, i16** %pp
+  %v = load i16, i16* %p
+  %next = getelementptr i16, i16* %p, i16 1000
+  store i16* %next, i16** %pp
+  ret i16 %v ;CHECK: jmp   {{.*JMP}}
+}
+
+
+; A copy loop uses a post-increment load and store for each element
+
+define void @copy_words(i16* %dst, i16* %src, i16 %n) {
+entry:
+;CHECK: copy_words:
+;CHECK: ldw ${{r[0-9]+}}, [${{r[0-9]+}}+, 2]        {{.*LDW_postinc}}
+;CHECK: stw [${{r[0-9]+}}+, 2], ${{r[0-9]+}}        {{.*STW_postinc}}
+  %cmp = icmp eq i16 %n, 0
+  br i1 %cmp, label %exit, label %loop
+
+loop:
+  %d = phi i16* [ %dst, %entry ], [ %d.next, %loop ]
+  %s = phi i16* [ %src, %entry ], [ %s.next, %loop ]
+  %i = phi i16 [ %n, %entry ], [ %i.next, %loop ]
+  %v = load i16, i16* %s
+  store i16 %v, i16* %d
+  %s.next = getelementptr i16, i16* %s, i16 1
+  %d.next = getelementptr i16, i16* %d, i16 1
+  %i.next = add i16 %i, -1
+  %done = icmp eq i16 %i.next, 0
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
@@ -0,0 +1,52 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s
+
+
+; Check that dense switches are lowered to a jump table
+
+
+define i16 @dense_switch(i16 %x) {
+entry:
+;CHECK: dense_switch:
+;CHECK: movi $[[TABLE:r[0-9]+]], .LJTI0_0        {{.*MOVI_i16}}
+;CHECK: ldw $[[DEST:r[0-9]+]], [${{r[0-9]+}}, 0] {{.*LDW}}
+;CHECK: jmp $[[DEST]]                            {{.*JMP}}
+  switch i16 %x, label %default [
+    i16 0, label %bb0
+    i16 1, label %bb1
+    i16 2, label %bb2
+    i16 3, label %bb3
+    i16 4, label %bb4
+    i16 5, label %bb5
+  ]
+
+bb0:
+  br label %exit
+bb1:
+  br label %exit
+bb2:
+  br label %exit
+bb3:
+  br label %exit
+bb4:
+  br label %exit
+bb5:
+  br label %exit
+default:
+  br label %exit
+
+exit:
+  %r = phi i16 [ 11, %bb0 ], [ 23, %bb1 ], [ 37, %bb2 ], [ 41, %bb3 ],
+               [ 53, %bb4 ], [ 67, %bb5 ], [ 0, %default ]
+  ret i16 %r
+}
+
+; The table is emitted in a data section, as 16-bit code addresses
+
+;CHECK: .section .rodata
+;CHECK: .LJTI0_0:
+;CHECK-NEXT: .short .LBB0_{{[0-9]+}}
+;CHECK-NEXT: .short .LBB0_{{[0-9]+}}
+;CHECK-NEXT: .short .LBB0_{{[0-9]+}}
+;CHECK-NEXT: .short .LBB0_{{[0-9]+}}
+;CHECK-NEXT: .short .LBB0_{{[0-9]+}}
+;CHECK-NEXT: .short .LBB0_{{[0-9]+}}
@@ -0,0 +1,67 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s
+
+
+; Check the stack adjustment of large frames, and that the frame setup is
+; shrink wrapped to the paths which need it
+
+
+declare void @use(i16*)
+
+
+; Small frames are adjusted with immediates
+
+define void @small_frame() {
+entry:
+;CHECK: small_frame:
+;CHECK-NOT: movi
+;CHECK: subi $r1, $r1, {{[0-9]+}}                {{.*SUBI_i10}}
+;CHECK: bal use
+;CHECK: addi $r1, $r1, {{[0-9]+}}                {{.*ADDI_i10}}
+  %buf = alloca [16 x i16]
+  %p = getelementptr [16 x i16], [16 x i16]* %buf, i16 0, i16 0
+  call void @use(i16* %p)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+; Large frames materialize the adjustment in a scratch register
+
+define void @large_frame() {
+entry:
+;CHECK: large_frame:
+;CHECK-NOT: subi $r1
+;CHECK: movi $[[REG:r[0-9]+]], {{[0-9]+}}        {{.*MOVI_i16}}
+;CHECK: sub $r1, $r1, $[[REG]]                   {{.*SUB_r}}
+;CHECK: bal use
+;CHECK: movi $[[REG2:r[0-9]+]], {{[0-9]+}}       {{.*MOVI_i16}}
+;CHECK: add $r1, $r1, $[[REG2]]                  {{.*ADD_r}}
+  %buf = alloca [3000 x i16]
+  %p = getelementptr [3000 x i16], [3000 x i16]* %buf, i16 0, i16 0
+  call void @use(i16* %p)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+; The early exit does not set up a frame
+
+@flag = global i16 0
+
+define void @shrink_wrap() {
+entry:
+;CHECK: shrink_wrap:
+;CHECK-NOT: $r1,
+;CHECK: beq
+;CHECK: subi $r1, $r1, {{[0-9]+}}                {{.*SUBI_i10}}
+;CHECK: bal use
+;CHECK: addi $r1, $r1, {{[0-9]+}}                {{.*ADDI_i10}}
+  %buf = alloca [16 x i16]
+  %n = load volatile i16, i16* @flag
+  %cmp = icmp eq i16 %n, 0
+  br i1 %cmp, label %exit, label %body
+
+body:
+  %p = getelementptr [16 x i16], [16 x i16]* %buf, i16 0, i16 0
+  call void @use(i16* %p)
+  br label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,64 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s
+; RUN: llc -asm-show-inst -march=aap -mattr=+abi-v2 < %s \
+; RUN:   | FileCheck %s -check-prefix=V2
+
+
+; Check that sequences repeated in functions optimized for minimum size are
+; outlined, and that the outlined function is called with BAL and returns
+; through a caller saved link register other than R0.
+
+
+@a = global i16 0
+@b = global i16 0
+@c = global i16 0
+
+
+define void @fill_1() #0 {
+entry:
+;CHECK-LABEL: fill_1:
+;CHECK: bal OUTLINED_FUNCTION_0, $r[[LINK:[1-9][0-9]*]]  {{.*BAL}}
+;V2-LABEL: fill_1:
+;V2: bal OUTLINED_FUNCTION_0, $r{{[2-7]}}  {{.*BAL}}
+  store volatile i16 1000, i16* @a
+  store volatile i16 2000, i16* @b
+  store volatile i16 3000, i16* @c
+  ret void
+}
+
+define void @fill_2() #0 {
+entry:
+;CHECK-LABEL: fill_2:
+;CHECK: bal OUTLINED_FUNCTION_0, $r[[LINK]]  {{.*BAL}}
+;V2-LABEL: fill_2:
+;V2: bal OUTLINED_FUNCTION_0, $r{{[2-7]}}  {{.*BAL}}
+  store volatile i16 1000, i16* @a
+  store volatile i16 2000, i16* @b
+  store volatile i16 3000, i16* @c
+  ret void
+}
+
+; Functions which are not optimized for minimum size are left alone
+
+define void @fill_3() {
+entry:
+;CHECK-LABEL: fill_3:
+;CHECK-NOT: bal
+;CHECK: jmp $r0
+;V2-LABEL: fill_3:
+;V2-NOT: bal
+;V2: jmp $r0
+  store volatile i16 1000, i16* @a
+  store volatile i16 2000, i16* @b
+  store volatile i16 3000, i16* @c
+  ret void
+}
+
+; The outlined function returns through its link register, using the short
+; jump when the link register is in GR8
+
+;CHECK-LABEL: OUTLINED_FUNCTION_0:
+;CHECK: jmp $r[[LINK]]  {{.*JMP}}
+;V2-LABEL: OUTLINED_FUNCTION_0:
+;V2: jmp $r{{[2-7]}}  {{.*JMP_short}}
+
+attributes #0 = { minsize optsize }
@@ -0,0 +1,113 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s
+
+
+; Check the inline expansion of memcpy, memmove and memset
+
+
+declare void @llvm.memcpy.p0i8.p0i8.i16(i8*, i8*, i16, i1)
+declare void @llvm.memmove.p0i8.p0i8.i16(i8*, i8*, i16, i1)
+declare void @llvm.memset.p0i8.i16(i8*, i8, i16, i1)
+
+
+; Small copies are unrolled
+
+define void @memcpy_small(i8* align 2 %dst, i8* align 2 %src) {
+entry:
+;CHECK: memcpy_small:
+;CHECK-NOT: bal
+;CHECK-COUNT-4: stw {{.*STW}}
+;CHECK-NOT: bal
+  call void @llvm.memcpy.p0i8.p0i8.i16(i8* align 2 %dst, i8* align 2 %src,
+                                       i16 8, i1 false)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+; Larger aligned copies use a loop of post-increment accesses
+
+define void @memcpy_loop(i8* align 2 %dst, i8* align 2 %src) {
+entry:
+;CHECK: memcpy_loop:
+;CHECK-NOT: bal
+;CHECK: [[LOOP:.LBB[0-9_]+]]:
+;CHECK: ldw ${{r[0-9]+}}, [${{r[0-9]+}}+, 2]   {{.*LDW_postinc}}
+;CHECK: stw [${{r[0-9]+}}+, 2], ${{r[0-9]+}}   {{.*STW_postinc}}
+;CHECK: bne [[LOOP]]
+  call void @llvm.memcpy.p0i8.p0i8.i16(i8* align 2 %dst, i8* align 2 %src,
+                                       i16 64, i1 false)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+; The odd byte of a copy is copied after the loop
+
+define void @memcpy_loop_odd(i8* align 2 %dst, i8* align 2 %src) {
+entry:
+;CHECK: memcpy_loop_odd:
+;CHECK: ldw ${{r[0-9]+}}, [${{r[0-9]+}}+, 2]   {{.*LDW_postinc}}
+;CHECK: stw [${{r[0-9]+}}+, 2], ${{r[0-9]+}}   {{.*STW_postinc}}
+;CHECK: ldb ${{r[0-9]+}}, [${{r[0-9]+}}, {{-?[0-9]+}}]   {{.*LDB}}
+;CHECK: stb [${{r[0-9]+}}, {{-?[0-9]+}}], ${{r[0-9]+}}   {{.*STB}}
+  call void @llvm.memcpy.p0i8.p0i8.i16(i8* align 2 %dst, i8* align 2 %src,
+                                       i16 65, i1 false)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+; Unaligned and variable sized copies call the library
+
+define void @memcpy_unaligned(i8* %dst, i8* %src) {
+entry:
+;CHECK: memcpy_unaligned:
+;CHECK: bal memcpy
+  call void @llvm.memcpy.p0i8.p0i8.i16(i8* %dst, i8* %src, i16 64, i1 false)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+define void @memcpy_variable(i8* align 2 %dst, i8* align 2 %src, i16 %n) {
+entry:
+;CHECK: memcpy_variable:
+;CHECK: bal memcpy
+  call void @llvm.memcpy.p0i8.p0i8.i16(i8* align 2 %dst, i8* align 2 %src,
+                                       i16 %n, i1 false)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+
+; Memmove copies forwards or backwards depending on the order of the
+; destination and source
+
+define void @memmove_loop(i8* align 2 %dst, i8* align 2 %src) {
+entry:
+;CHECK: memmove_loop:
+;CHECK-NOT: bal
+;CHECK: bltu
+;CHECK-DAG: ldw ${{r[0-9]+}}, [${{r[0-9]+}}+, 2]   {{.*LDW_postinc}}
+;CHECK-DAG: stw [${{r[0-9]+}}+, 2], ${{r[0-9]+}}   {{.*STW_postinc}}
+;CHECK-DAG: ldw ${{r[0-9]+}}, [-${{r[0-9]+}}, 2]   {{.*LDW_predec}}
+;CHECK-DAG: stw [-${{r[0-9]+}}, 2], ${{r[0-9]+}}   {{.*STW_predec}}
+  call void @llvm.memmove.p0i8.p0i8.i16(i8* align 2 %dst, i8* align 2 %src,
+                                        i16 64, i1 false)
+  ret void
+}
+
+define void @memmove_odd(i8* align 2 %dst, i8* align 2 %src) {
+entry:
+;CHECK: memmove_odd:
+;CHECK: bal memmove
+  call void @llvm.memmove.p0i8.p0i8.i16(i8* align 2 %dst, i8* align 2 %src,
+                                        i16 65, i1 false)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
+
+
+; Memset stores the fill byte replicated into a word
+
+define void @memset_loop(i8* align 2 %dst) {
+entry:
+;CHECK: memset_loop:
+;CHECK-NOT: bal
+;CHECK: movi ${{r[0-9]+}}, 2570
+;CHECK: [[LOOP:.LBB[0-9_]+]]:
+;CHECK: stw [${{r[0-9]+}}+, 2], ${{r[0-9]+}}   {{.*STW_postinc}}
+;CHECK: bne [[LOOP]]
+  call void @llvm.memset.p0i8.i16(i8* align 2 %dst, i8 10, i16 64, i1 false)
+  ret void ;CHECK: jmp   {{.*JMP}}
+}
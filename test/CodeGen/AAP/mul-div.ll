@@ -0,0 +1,110 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s --check-prefix=SOFT
+; RUN: llc -asm-show-inst -march=aap -mattr=+muldiv < %s \
+; RUN:   | FileCheck %s --check-prefix=HARD
+
+
+; Check multiply and divide with and without the multiply and divide unit
+
+
+define i16 @mul(i16 %a, i16 %b) {
+entry:
+;SOFT-LABEL: mul:
+;SOFT: bal __mulhi3
+;HARD-LABEL: mul:
+;HARD: mul $r2, $r2, $r3                   {{.*MUL_r}}
+  %r = mul i16 %a, %b
+  ret i16 %r
+}
+
+define i16 @mulhs(i16 %a, i16 %b) {
+entry:
+;HARD-LABEL: mulhs:
+;HARD: mulhs $r2, $r2, $r3                 {{.*MULHS_r}}
+  %a32 = sext i16 %a to i32
+  %b32 = sext i16 %b to i32
+  %m = mul i32 %a32, %b32
+  %h = lshr i32 %m, 16
+  %r = trunc i32 %h to i16
+  ret i16 %r
+}
+
+define i16 @sdiv(i16 %a, i16 %b) {
+entry:
+;SOFT-LABEL: sdiv:
+;SOFT: bal __divhi3
+;HARD-LABEL: sdiv:
+;HARD: divs $r2, $r2, $r3                  {{.*DIVS_r}}
+  %r = sdiv i16 %a, %b
+  ret i16 %r
+}
+
+define i16 @udiv(i16 %a, i16 %b) {
+entry:
+;HARD-LABEL: udiv:
+;HARD: divu $r2, $r2, $r3                  {{.*DIVU_r}}
+  %r = udiv i16 %a, %b
+  ret i16 %r
+}
+
+define i16 @srem(i16 %a, i16 %b) {
+entry:
+;HARD-LABEL: srem:
+;HARD: rems $r2, $r2, $r3                  {{.*REMS_r}}
+  %r = srem i16 %a, %b
+  ret i16 %r
+}
+
+define i16 @urem(i16 %a, i16 %b) {
+entry:
+;HARD-LABEL: urem:
+;HARD: remu $r2, $r2, $r3                  {{.*REMU_r}}
+  %r = urem i16 %a, %b
+  ret i16 %r
+}
+
+
+; Without the multiplier, multiplies by constants are shifts and adds
+
+define i16 @mul_10(i16 %a) {
+entry:
+;SOFT-LABEL: mul_10:
+;SOFT-NOT: bal
+;SOFT: lsli
+;SOFT: add
+;SOFT-NOT: bal
+;HARD-LABEL: mul_10:
+;HARD: mul
+  %r = mul i16 %a, 10
+  ret i16 %r
+}
+
+define i16 @mul_255(i16 %a) {
+entry:
+;SOFT-LABEL: mul_255:
+;SOFT-NOT: bal
+;SOFT: lsli ${{r[0-9]+}}, $r2, 8
+;SOFT: sub
+;SOFT-NOT: bal
+  %r = mul i16 %a, 255
+  ret i16 %r
+}
+
+define i16 @mul_neg3(i16 %a) {
+entry:
+;SOFT-LABEL: mul_neg3:
+;SOFT-NOT: bal
+;SOFT: sub
+;SOFT-NOT: bal
+  %r = mul i16 %a, -3
+  ret i16 %r
+}
+
+; Constants with too many non-zero digits still call the library
+
+define i16 @mul_many_terms(i16 %a) {
+entry:
+;SOFT-LABEL: mul_many_terms:
+;SOFT: bal __mulhi3
+  %r = mul i16 %a, 21845
+  ret i16 %r
+}
@@ -0,0 +1,94 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s
+; RUN: llc -asm-show-inst -march=aap -aap-branchless-select-cost=0 < %s \
+; RUN:   | FileCheck %s --check-prefix=BRANCH
+
+
+; Check that cheap selects are computed without branches, using a mask made
+; from the carry flag
+
+
+; Unsigned compares use the borrow of a subtraction
+
+define i16 @select_ult(i16 %a, i16 %b, i16 %x, i16 %y) {
+entry:
+;CHECK: select_ult:
+;CHECK-NOT: b{{[a-z]+}} .LBB
+;CHECK: sub $[[DIFF:r[0-9]+]], $r2, $r3                {{.*SUB_r}}
+;CHECK: subc $[[MASK:r[0-9]+]], $[[DIFF]], $[[DIFF]]   {{.*SUBC_r}}
+;CHECK: and ${{r[0-9]+}}, ${{r[0-9]+}}, $[[MASK]]
+;CHECK: xor
+;BRANCH: select_ult:
+;BRANCH: bltu .LBB
+  %cmp = icmp ult i16 %a, %b
+  %sel = select i1 %cmp, i16 %x, i16 %y
+  ret i16 %sel ;CHECK: jmp  {{.*JMP}}
+}
+
+; Unsigned saturating addition
+
+define i16 @uadd_sat(i16 %a, i16 %b) {
+entry:
+;CHECK: uadd_sat:
+;CHECK-NOT: b{{[a-z]+}} .LBB
+;CHECK: subc $[[MASK:r[0-9]+]]
+;CHECK: or ${{r[0-9]+}}, {{.*}}$[[MASK]]
+  %sum = add i16 %a, %b
+  %cmp = icmp ult i16 %sum, %a
+  %sel = select i1 %cmp, i16 -1, i16 %sum
+  ret i16 %sel ;CHECK: jmp  {{.*JMP}}
+}
+
+; Clamping a signed value at zero uses the sign bit as the mask
+
+define i16 @clamp_zero(i16 %a) {
+entry:
+;CHECK: clamp_zero:
+;CHECK-NOT: b{{[a-z]+}} .LBB
+;CHECK: asri ${{r[0-9]+}}, $r2, 15                     {{.*ASRI_i6}}
+  %cmp = icmp slt i16 %a, 0
+  %sel = select i1 %cmp, i16 0, i16 %a
+  ret i16 %sel ;CHECK: jmp  {{.*JMP}}
+}
+
+; Equality is tested by the borrow of subtracting one from the difference
+
+define i16 @setcc_eq(i16 %a, i16 %b) {
+entry:
+;CHECK: setcc_eq:
+;CHECK-NOT: b{{[a-z]+}} .LBB
+;CHECK: xor $[[DIFF:r[0-9]+]], $r2, $r3                {{.*XOR_r}}
+;CHECK: subi $[[DEC:r[0-9]+]], $[[DIFF]], 1            {{.*SUBI}}
+;CHECK: subc $[[MASK:r[0-9]+]], $[[DEC]], $[[DEC]]     {{.*SUBC_r}}
+;CHECK: andi $r2, $[[MASK]], 1                         {{.*ANDI_i9}}
+  %cmp = icmp eq i16 %a, %b
+  %res = zext i1 %cmp to i16
+  ret i16 %res ;CHECK: jmp  {{.*JMP}}
+}
+
+; Zero compared as the first operand of a signed compare flips to the sign
+; bit, so it shares the register holding the sign bit
+
+define i16 @setcc_sgt_zero(i16 %a) {
+entry:
+;CHECK: setcc_sgt_zero:
+;CHECK-NOT: b{{[a-z]+}} .LBB
+;CHECK: movi $[[SIGN:r[0-9]+]], -32768                  {{.*MOVI_i16}}
+;CHECK: xor $[[FLIP:r[0-9]+]], $r2, $[[SIGN]]          {{.*XOR_r}}
+;CHECK: sub $[[DIFF:r[0-9]+]], $[[SIGN]], $[[FLIP]]    {{.*SUB_r}}
+;CHECK: subc $[[MASK:r[0-9]+]], $[[DIFF]], $[[DIFF]]   {{.*SUBC_r}}
+;CHECK: andi $r2, $[[MASK]], 1                         {{.*ANDI_i9}}
+  %cmp = icmp sgt i16 %a, 0
+  %res = zext i1 %cmp to i16
+  ret i16 %res ;CHECK: jmp  {{.*JMP}}
+}
+
+; Signed compares of two variables are more expensive than a branch
+
+define i16 @select_slt(i16 %a, i16 %b, i16 %x, i16 %y) {
+entry:
+;CHECK: select_slt:
+;CHECK: blts .LBB
+  %cmp = icmp slt i16 %a, %b
+  %sel = select i1 %cmp, i16 %x, i16 %y
+  ret i16 %sel ;CHECK: jmp  {{.*JMP}}
+}
@@ -0,0 +1,100 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s
+; RUN: llc -asm-show-inst -march=aap -aap-short-reg-hint-threshold=1000000 \
+; RUN:   < %s | FileCheck %s -check-prefix=NOHINT
+
+
+; Check that registers used in hot code are allocated to the registers with
+; short encodings, even though these are callee saved and a caller saved
+; register would otherwise be preferred
+
+
+@g = global [8 x i16] zeroinitializer
+
+
+define i16 @hot_loop(i16* %p, i16 %n) {
+entry:
+;CHECK: hot_loop:
+;CHECK: [[LOOP:.LBB[0-9_]+]]:
+;CHECK: ldw ${{r[0-7]}}, [${{r[0-7]}}+, 2]     {{.*LDW_postinc_short}}
+;CHECK: bne [[LOOP]]
+;NOHINT: hot_loop:
+;NOHINT: [[LOOP:.LBB[0-9_]+]]:
+;NOHINT: ldw ${{r[0-9]+}}, [${{r[0-9]+}}+, 2]  {{.*LDW_postinc$}}
+;NOHINT: bne [[LOOP]]
+  br label %loop
+
+loop:
+  %ptr = phi i16* [ %p, %entry ], [ %ptr.next, %loop ]
+  %i = phi i16 [ %n, %entry ], [ %i.next, %loop ]
+  %sum = phi i16 [ 0, %entry ], [ %sum.next, %loop ]
+  %v = load i16, i16* %ptr
+  %sum.next = add i16 %sum, %v
+  %ptr.next = getelementptr i16, i16* %ptr, i16 1
+  %i.next = add i16 %i, -1
+  %done = icmp eq i16 %i.next, 0
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i16 %sum.next
+}
+
+; When more values are live across the loop than there are registers in GR8,
+; the values used in the loop are hinted before the colder values used only
+; after it, which are left in registers without short encodings
+
+define i16 @hot_and_cold(i16* %p, i16 %n) {
+entry:
+;CHECK: hot_and_cold:
+;CHECK: [[LOOP:.LBB[0-9_]+]]:
+;CHECK: ldw ${{r[0-7]}}, [${{r[0-7]}}+, 2]     {{.*LDW_postinc_short}}
+;CHECK: add ${{r[0-7]}}, ${{r[0-7]}}, ${{r[0-7]}} {{.*ADD_r_short}}
+;CHECK: bne [[LOOP]]
+;CHECK: xor ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}} {{.*XOR_r$}}
+  %g0 = getelementptr [8 x i16], [8 x i16]* @g, i16 0, i16 0
+  %g1 = getelementptr [8 x i16], [8 x i16]* @g, i16 0, i16 1
+  %g2 = getelementptr [8 x i16], [8 x i16]* @g, i16 0, i16 2
+  %g3 = getelementptr [8 x i16], [8 x i16]* @g, i16 0, i16 3
+  %g4 = getelementptr [8 x i16], [8 x i16]* @g, i16 0, i16 4
+  %g5 = getelementptr [8 x i16], [8 x i16]* @g, i16 0, i16 5
+  %g6 = getelementptr [8 x i16], [8 x i16]* @g, i16 0, i16 6
+  %g7 = getelementptr [8 x i16], [8 x i16]* @g, i16 0, i16 7
+  %c0 = load volatile i16, i16* %g0
+  %c1 = load volatile i16, i16* %g1
+  %c2 = load volatile i16, i16* %g2
+  %c3 = load volatile i16, i16* %g3
+  %c4 = load volatile i16, i16* %g4
+  %c5 = load volatile i16, i16* %g5
+  %c6 = load volatile i16, i16* %g6
+  %c7 = load volatile i16, i16* %g7
+  br label %loop
+
+loop:
+  %ptr = phi i16* [ %p, %entry ], [ %ptr.next, %loop ]
+  %i = phi i16 [ %n, %entry ], [ %i.next, %loop ]
+  %sum = phi i16 [ 0, %entry ], [ %sum.next, %loop ]
+  %v = load i16, i16* %ptr
+  %sum.next = add i16 %sum, %v
+  %ptr.next = getelementptr i16, i16* %ptr, i16 1
+  %i.next = add i16 %i, -1
+  %done = icmp eq i16 %i.next, 0
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %x0 = xor i16 %c0, %c1
+  %x1 = xor i16 %c2, %c3
+  %x2 = xor i16 %c4, %c5
+  %x3 = xor i16 %c6, %c7
+  %a0 = and i16 %c0, %c1
+  %a1 = and i16 %c2, %c3
+  %a2 = and i16 %c4, %c5
+  %a3 = and i16 %c6, %c7
+  %s0 = add i16 %x0, %a0
+  %s1 = add i16 %x1, %a1
+  %s2 = add i16 %x2, %a2
+  %s3 = add i16 %x3, %a3
+  %t0 = add i16 %s0, %s1
+  %t1 = add i16 %s2, %s3
+  %t2 = add i16 %t0, %t1
+  %r = add i16 %t2, %sum.next
+  ret i16 %r
+}
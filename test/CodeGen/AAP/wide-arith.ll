@@ -0,0 +1,95 @@
+; RUN: llc -asm-show-inst -march=aap < %s | FileCheck %s
+
+
+; Check that wide additions and subtractions are chained through the carry
+; flag, and that wide shifts are lowered inline. -asm-show-inst prints the
+; operands of each instruction on the lines after it, so nothing may be
+; scheduled between the parts of a chain, where it could clobber the flag.
+
+
+define i32 @add_i32(i32 %x, i32 %y) {
+entry:
+;CHECK: add_i32:
+;CHECK: add ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}    {{.*ADD_r}}
+;CHECK-NOT: MCInst
+;CHECK: addc ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}   {{.*ADDC_r}}
+  %0 = add i32 %x, %y
+  ret i32 %0 ;CHECK: jmp  {{.*JMP}}
+}
+
+define i32 @add_i32_imm(i32 %x) {
+entry:
+;CHECK: add_i32_imm:
+;CHECK: addi ${{r[0-9]+}}, ${{r[0-9]+}}, 100           {{.*ADDI_i10}}
+;CHECK-NOT: MCInst
+;CHECK: addc ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}   {{.*ADDC_r}}
+  %0 = add i32 %x, 100
+  ret i32 %0 ;CHECK: jmp  {{.*JMP}}
+}
+
+define i32 @sub_i32(i32 %x, i32 %y) {
+entry:
+;CHECK: sub_i32:
+;CHECK-NOT: bltu
+;CHECK: sub ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}    {{.*SUB_r}}
+;CHECK-NOT: MCInst
+;CHECK: subc ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}   {{.*SUBC_r}}
+  %0 = sub i32 %x, %y
+  ret i32 %0 ;CHECK: jmp  {{.*JMP}}
+}
+
+define i64 @add_i64(i64 %x, i64 %y) {
+entry:
+;CHECK: add_i64:
+;CHECK: add ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}    {{.*ADD_r}}
+;CHECK-NOT: MCInst
+;CHECK: addc ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}   {{.*ADDC_r}}
+;CHECK-NOT: MCInst
+;CHECK: addc ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}   {{.*ADDC_r}}
+;CHECK-NOT: MCInst
+;CHECK: addc ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}   {{.*ADDC_r}}
+  %0 = add i64 %x, %y
+  ret i64 %0 ;CHECK: jmp  {{.*JMP}}
+}
+
+
+; Wide shifts by a constant combine the shifted parts
+
+define i32 @shl_i32_imm(i32 %x) {
+entry:
+;CHECK: shl_i32_imm:
+;CHECK-NOT: bal
+;CHECK-DAG: lsli ${{r[0-9]+}}, ${{r[0-9]+}}, 3
+;CHECK-DAG: lsri ${{r[0-9]+}}, ${{r[0-9]+}}, 13
+  %0 = shl i32 %x, 3
+  ret i32 %0 ;CHECK: jmp  {{.*JMP}}
+}
+
+; Wide shifts by a variable amount do not call the runtime library
+
+define i32 @shl_i32(i32 %x, i32 %y) {
+entry:
+;CHECK: shl_i32:
+;CHECK-NOT: bal
+;CHECK: lsl ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}    {{.*LSL_r}}
+  %0 = shl i32 %x, %y
+  ret i32 %0 ;CHECK: jmp  {{.*JMP}}
+}
+
+define i32 @lshr_i32(i32 %x, i32 %y) {
+entry:
+;CHECK: lshr_i32:
+;CHECK-NOT: bal
+;CHECK: lsr ${{r[0-9]+}}, ${{r[0-9]+}}, ${{r[0-9]+}}    {{.*LSR_r}}
+  %0 = lshr i32 %x, %y
+  ret i32 %0 ;CHECK: jmp  {{.*JMP}}
+}
+
+define i32 @ashr_i32(i32 %x, i32 %y) {
+entry:
+;CHECK: ashr_i32:
+;CHECK-NOT: bal
+;CHECK: asri ${{r[0-9]+}}, ${{r[0-9]+}}, 15             {{.*ASRI}}
+  %0 = ashr i32 %x, %y
+  ret i32 %0 ;CHECK: jmp  {{.*JMP}}
+}
@@ -0,0 +1,16 @@
+; RUN: llvm-mc -triple=aap -mattr=+muldiv -show-encoding %s | FileCheck %s
+; RUN: not llvm-mc -triple=aap %s 2>&1 | FileCheck --check-prefix=NOMULDIV %s
+
+; Multiply and divide instructions of the optional multiply and divide unit.
+; These only have long encodings.
+
+mul   $r2,  $r3,  $r4   ;CHECK: mul   $r2,  $r3,  $r4  ; encoding: [0x9c,0x8c,0x00,0x02]
+mul   $r9,  $r1,  $r5   ;CHECK: mul   $r9,  $r1,  $r5  ; encoding: [0x4d,0x8c,0x40,0x02]
+mulhs $r2,  $r3,  $r4   ;CHECK: mulhs $r2,  $r3,  $r4  ; encoding: [0x9c,0x8e,0x00,0x02]
+mulhu $r7,  $r7,  $r7   ;CHECK: mulhu $r7,  $r7,  $r7  ; encoding: [0xff,0x91,0x00,0x02]
+divs  $r2,  $r2,  $r3   ;CHECK: divs  $r2,  $r2,  $r3  ; encoding: [0x93,0x92,0x00,0x02]
+divu  $r10, $r20, $r30  ;CHECK: divu  $r10, $r20, $r30 ; encoding: [0xa6,0x98,0x53,0x02]
+rems  $r0,  $r1,  $r2   ;CHECK: rems  $r0,  $r1,  $r2  ; encoding: [0x0a,0x9a,0x00,0x02]
+remu  $r63, $r62, $r61  ;CHECK: remu  $r63, $r62, $r61 ; encoding: [0xf5,0x9d,0xff,0x03]
+
+;NOMULDIV: error: Use of this instruction requires: muldiv
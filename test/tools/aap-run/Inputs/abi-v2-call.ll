@@ -0,0 +1,27 @@
+; Source of the caller and callee in abi-v2-call.test. Six i16 arguments
+; are passed in registers, and the i32 is passed on the stack.
+
+define void @start() {
+entry:
+  %k = call i16 asm sideeffect "movi $0, 1000", "=r"()
+  %r = call i16 @callee(i16 1, i16 2, i16 3, i16 4, i16 5, i16 6, i32 196617)
+  %s = add i16 %r, %k
+  call void asm sideeffect "nop $0, 2", "r"(i16 %s)
+  unreachable
+}
+
+define i16 @callee(i16 %a, i16 %b, i16 %c, i16 %d, i16 %e, i16 %f, i32 %g) {
+entry:
+  %lo = trunc i32 %g to i16
+  %hi.32 = lshr i32 %g, 16
+  %hi = trunc i32 %hi.32 to i16
+  %s1 = sub i16 %a, %b
+  %s2 = add i16 %s1, %c
+  %s3 = sub i16 %s2, %d
+  %s4 = add i16 %s3, %e
+  %s5 = sub i16 %s4, %f
+  %s6 = add i16 %s5, %lo
+  %s7 = mul i16 %hi, 100
+  %s8 = add i16 %s6, %s7
+  ret i16 %s8
+}
@@ -0,0 +1,43 @@
+; Source of the program profiled by profile-flat.test and profile-sample.test.
+; start calls add3 three times, and exits with the sum of the results.
+
+define void @start() !dbg !7 {
+entry:
+  br label %loop, !dbg !10
+
+loop:
+  %i = phi i16 [ 0, %entry ], [ %i.next, %loop ], !dbg !11
+  %sum = phi i16 [ 0, %entry ], [ %sum.next, %loop ], !dbg !11
+  %r = call i16 @add3(i16 %i), !dbg !11
+  %sum.next = add i16 %sum, %r, !dbg !11
+  %i.next = add i16 %i, 1, !dbg !12
+  %done = icmp eq i16 %i.next, 3, !dbg !12
+  br i1 %done, label %exit, label %loop, !dbg !12
+
+exit:
+  call void asm sideeffect "nop $0, 2", "r"(i16 %sum.next), !dbg !13
+  unreachable, !dbg !13
+}
+
+define i16 @add3(i16 %x) noinline !dbg !14 {
+entry:
+  %y = add i16 %x, 3, !dbg !15
+  ret i16 %y, !dbg !15
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3, !4}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "hand written", isOptimized: true, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "prof.c", directory: "/")
+!2 = !{}
+!3 = !{i32 2, !"Dwarf Version", i32 4}
+!4 = !{i32 2, !"Debug Info Version", i32 3}
+!6 = !DISubroutineType(types: !2)
+!7 = distinct !DISubprogram(name: "start", scope: !1, file: !1, line: 1, type: !6, isLocal: false, isDefinition: true, scopeLine: 1, isOptimized: true, unit: !0)
+!10 = !DILocation(line: 2, scope: !7)
+!11 = !DILocation(line: 3, scope: !7)
+!12 = !DILocation(line: 4, scope: !7)
+!13 = !DILocation(line: 5, scope: !7)
+!14 = distinct !DISubprogram(name: "add3", scope: !1, file: !1, line: 8, type: !6, isLocal: false, isDefinition: true, scopeLine: 8, isOptimized: true, unit: !0)
+!15 = !DILocation(line: 9, scope: !14)
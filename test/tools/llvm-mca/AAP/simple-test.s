@@ -0,0 +1,57 @@
+# RUN: llvm-mca -mtriple=aap -mcpu=generic -iterations=2 -timeline < %s \
+# RUN:   | FileCheck %s
+
+# Check that llvm-mca can simulate AAP code using the AAP scheduling model.
+# Instructions issue in order, a load result is available two cycles later,
+# and long encodings occupy the fetch unit for two cycles.
+
+ldw   $r2, [$r3, 0]
+add   $r4, $r2, $r5
+lsli  $r4, $r4, 1
+stw   [$r3+, 2], $r4
+ldw   $r20, [$r30, 0]
+
+# CHECK:      Iterations:        2
+# CHECK-NEXT: Instructions:      10
+# CHECK-NEXT: Total Cycles:      18
+# CHECK-NEXT: Dispatch Width:    1
+# CHECK-NEXT: IPC:               0.56
+# CHECK-NEXT: Block RThroughput: 6.0
+
+# CHECK:      [1]    [2]    [3]    [4]    [5]    [6]    Instructions:
+# CHECK-NEXT:  1      2     1.00    *                   ldw $r2, [$r3, 0]
+# CHECK-NEXT:  1      1     1.00                        add $r4, $r2, $r5
+# CHECK-NEXT:  1      2     2.00                        lsli $r4, $r4, 1
+# CHECK-NEXT:  1      1     1.00           *            stw [$r3+, 2], $r4
+# CHECK-NEXT:  1      2     2.00    *                   ldw $r20, [$r30, 0]
+
+# CHECK:      Resources:
+# CHECK-NEXT: [0]   - AAPUnitALU
+# CHECK-NEXT: [1]   - AAPUnitBr
+# CHECK-NEXT: [2]   - AAPUnitDiv
+# CHECK-NEXT: [3]   - AAPUnitFetch
+# CHECK-NEXT: [4]   - AAPUnitMem
+# CHECK-NEXT: [5]   - AAPUnitMul
+
+# CHECK:      Resource pressure by instruction:
+# CHECK-NEXT: [0]    [1]    [2]    [3]    [4]    [5]    Instructions:
+# CHECK-NEXT:  -      -      -     1.00   1.00    -     ldw $r2, [$r3, 0]
+# CHECK-NEXT: 1.00    -      -     1.00    -      -     add $r4, $r2, $r5
+# CHECK-NEXT: 2.00    -      -     1.00    -      -     lsli $r4, $r4, 1
+# CHECK-NEXT:  -      -      -     1.00   1.00    -     stw [$r3+, 2], $r4
+# CHECK-NEXT:  -      -      -     2.00   1.00    -     ldw $r20, [$r30, 0]
+
+# CHECK:      Timeline view:
+# CHECK-NEXT:                     01234567
+# CHECK-NEXT: Index     0123456789
+
+# CHECK:      [0,0]     DeER .    .    . .   ldw $r2, [$r3, 0]
+# CHECK-NEXT: [0,1]     .DeER.    .    . .   add $r4, $r2, $r5
+# CHECK-NEXT: [0,2]     .  DeER   .    . .   lsli $r4, $r4, 1
+# CHECK-NEXT: [0,3]     .   DeER  .    . .   stw [$r3+, 2], $r4
+# CHECK-NEXT: [0,4]     .    .DeER.    . .   ldw $r20, [$r30, 0]
+# CHECK-NEXT: [1,0]     .    .  DeER   . .   ldw $r2, [$r3, 0]
+# CHECK-NEXT: [1,1]     .    .   DeER  . .   add $r4, $r2, $r5
+# CHECK-NEXT: [1,2]     .    .    .DeER. .   lsli $r4, $r4, 1
+# CHECK-NEXT: [1,3]     .    .    . DeER .   stw [$r3+, 2], $r4
+# CHECK-NEXT: [1,4]     .    .    .   DeER   ldw $r20, [$r30, 0]
@@ -0,0 +1,200 @@
+//===-- AAPProfileWriter.cpp - AAP Simulator Profile Output ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides the implementation of the profile writer
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Object/ELFObjectFile.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "AAPProfileWriter.h"
+#include <algorithm>
+#include <map>
+
+using namespace llvm;
+using namespace object;
+using namespace AAPSim;
+
+AAPProfileWriter::AAPProfileWriter(const ObjectFile &Obj, uint64_t CodeBase)
+    : CodeBase(CodeBase) {
+  for (const SymbolRef &Sym : Obj.symbols()) {
+    Expected<SymbolRef::Type> Type = Sym.getType();
+    Expected<uint64_t> Address = Sym.getAddress();
+    Expected<StringRef> Name = Sym.getName();
+    if (!Type || !Address || !Name) {
+      consumeError(Type.takeError());
+      consumeError(Address.takeError());
+      consumeError(Name.takeError());
+      continue;
+    }
+    // Only functions in code memory are of interest
+    if (*Type != SymbolRef::ST_Function || !(*Address & 0x8000000))
+      continue;
+    uint64_t Size = 0;
+    if (isa<ELFObjectFileBase>(&Obj))
+      Size = ELFSymbolRef(Sym).getSize();
+    uint32_t Start = (*Address & 0xffffff) >> 1;
+    Functions.push_back({Start, Start + static_cast<uint32_t>(Size >> 1),
+                         Name->str()});
+  }
+
+  // Functions without a size extend up to the next function
+  std::sort(Functions.begin(), Functions.end(),
+            [](const Function &A, const Function &B) {
+              return A.Start < B.Start;
+            });
+  for (size_t i = 0, e = Functions.size(); i != e; ++i) {
+    if (Functions[i].End > Functions[i].Start)
+      continue;
+    Functions[i].End = (i + 1 != e) ? Functions[i + 1].Start : 0x1000000;
+  }
+
+  DICtx = DWARFContext::create(Obj);
+}
+
+const AAPProfileWriter::Function *
+AAPProfileWriter::lookup(uint32_t pc_w) const {
+  auto It = std::upper_bound(Functions.begin(), Functions.end(), pc_w,
+                             [](uint32_t PC, const Function &F) {
+                               return PC < F.Start;
+                             });
+  if (It == Functions.begin())
+    return nullptr;
+  --It;
+  return pc_w < It->End ? &*It : nullptr;
+}
+
+// Code not covered by any function symbol is gathered into one bucket,
+// rather than reporting each of its instructions as a function
+static const char UnknownFunction[] = "<unknown>";
+
+std::string AAPProfileWriter::getName(uint32_t pc_w) const {
+  if (const Function *F = lookup(pc_w))
+    return F->Name;
+  return UnknownFunction;
+}
+
+bool AAPProfileWriter::hasLineTable() const {
+  for (const auto &CU : DICtx->compile_units()) {
+    const DWARFDebugLine::LineTable *LT = DICtx->getLineTableForUnit(CU.get());
+    if (LT && !LT->Rows.empty())
+      return true;
+  }
+  return false;
+}
+
+void AAPProfileWriter::writeFlat(raw_ostream &OS,
+                                 const AAPSimStats &Stats) const {
+  // Attribute every instruction and call to a function
+  std::map<std::string, uint64_t> Self, Calls;
+  std::map<std::pair<std::string, std::string>, uint64_t> Edges;
+  uint64_t Total = 0;
+  for (const auto &Entry : Stats.InstCounts) {
+    Self[getName(Entry.first)] += Entry.second;
+    Total += Entry.second;
+  }
+  for (const auto &Entry : Stats.CallCounts) {
+    std::string Callee = getName(Entry.first.second);
+    Calls[Callee] += Entry.second;
+    Edges[std::make_pair(getName(Entry.first.first), Callee)] += Entry.second;
+  }
+
+  std::vector<std::pair<std::string, uint64_t>> Sorted(Self.begin(),
+                                                       Self.end());
+  std::stable_sort(Sorted.begin(), Sorted.end(),
+                   [](const std::pair<std::string, uint64_t> &A,
+                      const std::pair<std::string, uint64_t> &B) {
+                     return A.second > B.second;
+                   });
+
+  OS << "Flat profile: " << Total << " instructions\n";
+  OS << "       insts       %      calls  function\n";
+  for (const auto &Entry : Sorted) {
+    double Percent = Total ? 100.0 * Entry.second / Total : 0.0;
+    OS << format("%12" PRIu64 " %7.2f %10" PRIu64 "  ", Entry.second, Percent,
+                 Calls[Entry.first])
+       << Entry.first << "\n";
+  }
+
+  OS << "\nCall graph:\n";
+  for (const auto &Entry : Edges)
+    OS << "  " << Entry.first.first << " -> " << Entry.first.second << ": "
+       << Entry.second << "\n";
+}
+
+void AAPProfileWriter::writeSampleProfile(raw_ostream &OS,
+                                          const AAPSimStats &Stats) const {
+  // Line offset and discriminator of a sample
+  typedef std::pair<uint32_t, uint32_t> LineKey;
+  struct FunctionSamples {
+    std::map<LineKey, uint64_t> Body;
+    std::map<LineKey, std::map<std::string, uint64_t>> CallTargets;
+  };
+  std::map<const Function *, FunctionSamples> Samples;
+
+  DILineInfoSpecifier Spec(
+      DILineInfoSpecifier::FileLineInfoKind::Default,
+      DILineInfoSpecifier::FunctionNameKind::LinkageName);
+
+  // Find the line of an instruction relative to the start of its function.
+  // Instructions inlined from other functions are not attributed, since
+  // their lines are relative to a different function.
+  auto getLineKey = [&](const Function &F, uint32_t pc_w, LineKey &Key) {
+    DILineInfo Info =
+        DICtx->getLineInfoForAddress(CodeBase | (pc_w << 1), Spec);
+    if (Info.Line == 0 || Info.FunctionName != F.Name ||
+        Info.Line < Info.StartLine)
+      return false;
+    Key = LineKey(Info.Line - Info.StartLine, Info.Discriminator);
+    return true;
+  };
+
+  // The count of a line is the highest count of any of its instructions
+  for (const auto &Entry : Stats.InstCounts) {
+    const Function *F = lookup(Entry.first);
+    LineKey Key;
+    if (!F || !getLineKey(*F, Entry.first, Key))
+      continue;
+    uint64_t &Count = Samples[F].Body[Key];
+    Count = std::max(Count, Entry.second);
+  }
+  // Calls into unknown code have no function to name as their target
+  for (const auto &Entry : Stats.CallCounts) {
+    const Function *F = lookup(Entry.first.first);
+    LineKey Key;
+    if (!F || !lookup(Entry.first.second) ||
+        !getLineKey(*F, Entry.first.first, Key))
+      continue;
+    Samples[F].CallTargets[Key][getName(Entry.first.second)] += Entry.second;
+  }
+
+  for (const auto &FS : Samples) {
+    const Function &F = *FS.first;
+    uint64_t Total = 0;
+    for (const auto &Line : FS.second.Body)
+      Total += Line.second;
+    auto Head = Stats.InstCounts.find(F.Start);
+    OS << F.Name << ":" << Total << ":"
+       << (Head != Stats.InstCounts.end() ? Head->second : 0) << "\n";
+
+    for (const auto &Line : FS.second.Body) {
+      OS << " " << Line.first.first;
+      if (Line.first.second)
+        OS << "." << Line.first.second;
+      OS << ": " << Line.second;
+      auto Targets = FS.second.CallTargets.find(Line.first);
+      if (Targets != FS.second.CallTargets.end())
+        for (const auto &Target : Targets->second)
+          OS << " " << Target.first << ":" << Target.second;
+      OS << "\n";
+    }
+  }
+}
@@ -0,0 +1,67 @@
+//===-- AAPProfileWriter.h - AAP Simulator Profile Output -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file attributes the instruction and call counts collected by the AAP
+// simulator to the functions of the simulated binary.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_AAP_RUN_AAPPROFILEWRITER_H
+#define LLVM_TOOLS_AAP_RUN_AAPPROFILEWRITER_H
+
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/Object/ObjectFile.h"
+#include "AAPSimStats.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AAPSim {
+
+/// AAPProfileWriter - writes execution profiles using the ELF symbol table
+/// and line tables of the simulated binary.
+class AAPProfileWriter {
+  struct Function {
+    uint32_t Start;   // Code word address of the first instruction
+    uint32_t End;     // Code word address after the last instruction
+    std::string Name;
+  };
+
+  // Functions sorted by start address
+  std::vector<Function> Functions;
+
+  // Line tables, used for sample profiles
+  std::unique_ptr<llvm::DWARFContext> DICtx;
+
+  // Bits of ELF code addresses above the 24-bit code space
+  uint64_t CodeBase;
+
+  const Function *lookup(uint32_t pc_w) const;
+  std::string getName(uint32_t pc_w) const;
+
+public:
+  AAPProfileWriter(const llvm::object::ObjectFile &Obj, uint64_t CodeBase);
+
+  /// Return true if the binary has a line table, without which a sample
+  /// profile has nothing to attribute its counts to.
+  bool hasLineTable() const;
+
+  /// Write a flat profile of instructions executed by each function,
+  /// followed by the call graph.
+  void writeFlat(llvm::raw_ostream &OS, const AAPSimStats &Stats) const;
+
+  /// Write a profile in the sample profile text format accepted by
+  /// llvm-profdata. Sample counts are exact execution counts.
+  void writeSampleProfile(llvm::raw_ostream &OS,
+                          const AAPSimStats &Stats) const;
+};
+
+} // End AAPSim namespace
+
+#endif
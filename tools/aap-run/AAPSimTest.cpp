@@ -11,14 +11,26 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/TargetRegistry.h"
-#include "llvm/Support/TargetSelect.h"
+#include "AAPProfileWriter.h"
 #include "AAPSimulator.h"
 #include "AAPSimState.h"
 
@@ -27,7 +39,7 @@ using namespace object;
 using namespace AAPSim;
 
 static cl::opt<std::string>
-InputFilename(cl::Positional, cl::Required, cl::desc("<input object>"));
+InputFilename(cl::Positional, cl::Optional, cl::desc("<input object>"));
 
 static std::string ToolName;
 
@@ -37,7 +49,54 @@ static void report_error(StringRef File, std::error_code EC) {
   exit(1);
 }
 
-static void LoadObject(AAPSimulator &Sim, ObjectFile *o) {
+// Load the PT_LOAD segments of an executable, mapping them from the file
+// where possible. Loaded is set if there were any segments to load.
+static std::error_code LoadSegments(AAPSimulator &Sim,
+                                    const ELF32LEObjectFile *o, int FD,
+                                    raw_ostream &Log, uint64_t &CodeBase,
+                                    bool &Loaded) {
+  Loaded = false;
+  auto ProgramHeaders = o->getELFFile()->program_headers();
+  if (!ProgramHeaders) {
+    consumeError(ProgramHeaders.takeError());
+    return std::error_code();
+  }
+  StringRef Data = o->getData();
+  unsigned i = 0;
+  for (const auto &Phdr : *ProgramHeaders) {
+    if (Phdr.p_type != ELF::PT_LOAD)
+      continue;
+    uint64_t Address = Phdr.p_vaddr;
+    uint64_t Offset = Phdr.p_offset;
+    uint64_t Size = Phdr.p_filesz;
+    if (Offset > Data.size() || Size > Data.size() - Offset)
+      return object_error::parse_failed;
+    StringRef BytesStr = Data.substr(Offset, Size);
+    bool TextFlag = Address & 0x8000000;
+    const char *Type = TextFlag ? "TEXT" : "DATA";
+    Log << format("%3d PT_LOAD       %08" PRIx64 " %016" PRIx64 " %s\n", i,
+                  Size, Address, Type);
+    bool Fits;
+    if (TextFlag) {
+      CodeBase = Address & ~0xffffffULL;
+      Address = Address & 0xffffff;
+      Log << format("Mapping segment %d to %06" PRIx64 "\n", i, Address);
+      Fits = Sim.WriteCodeSection(BytesStr, Address, FD, Offset);
+    } else {
+      Address = Address & 0xffff;
+      Log << format("Mapping segment %d to %04" PRIx64 "\n", i, Address);
+      Fits = Sim.WriteDataSection(BytesStr, Address, FD, Offset);
+    }
+    if (!Fits)
+      return object_error::parse_failed;
+    Loaded = true;
+    ++i;
+  }
+  return std::error_code();
+}
+
+static std::error_code LoadSections(AAPSimulator &Sim, ObjectFile *o,
+                                    raw_ostream &Log, uint64_t &CodeBase) {
   unsigned i = 0;
   for (const SectionRef &Section : o->sections()) {
     StringRef Name;
@@ -52,37 +111,70 @@ static void LoadObject(AAPSimulator &Sim, ObjectFile *o) {
     Section.getContents(BytesStr);
     std::string Type = (std::string(Text ? "TEXT " : "") +
                         (Data ? "DATA " : "") + (BSS ? "BSS" : ""));
-    // FIXME: We should really load based on LOAD segment flag
     if (Text || Data) {
-      outs() << format("%3d %-13s %08" PRIx64 " %016" PRIx64 " %s\n", i,
-                       Name.str().c_str(), Size, Address, Type.c_str());
+      Log << format("%3d %-13s %08" PRIx64 " %016" PRIx64 " %s\n", i,
+                    Name.str().c_str(), Size, Address, Type.c_str());
       if (TextFlag) {
+        CodeBase = Address & ~0xffffffULL;
         Address = Address & 0xffffff;
-        outs() << format("Writing %s to %06" PRIx64 "\n", Name.str().c_str(), Address);
-        Sim.WriteCodeSection(BytesStr, Address);
+        Log << format("Writing %s to %06" PRIx64 "\n", Name.str().c_str(), Address);
+        if (!Sim.WriteCodeSection(BytesStr, Address))
+          return object_error::parse_failed;
       } else {
         Address = Address & 0xffff;
-        outs() << format("Writing %s to %04" PRIx64 "\n", Name.str().c_str(), Address);
-        Sim.WriteDataSection(BytesStr, Address);
+        Log << format("Writing %s to %04" PRIx64 "\n", Name.str().c_str(), Address);
+        if (!Sim.WriteDataSection(BytesStr, Address))
+          return object_error::parse_failed;
       }
     }
     ++i;
   }
+  return std::error_code();
+}
+
+static std::error_code LoadObject(AAPSimulator &Sim, ObjectFile *o, int FD,
+                                  raw_ostream &Log, uint64_t &CodeBase) {
+  // Executables are loaded by segment, falling back to loading sections for
+  // relocatable objects.
+  bool Loaded = false;
+  if (const auto *ELFObj = dyn_cast<ELF32LEObjectFile>(o))
+    if (std::error_code EC =
+            LoadSegments(Sim, ELFObj, FD, Log, CodeBase, Loaded))
+      return EC;
+  if (!Loaded)
+    if (std::error_code EC = LoadSections(Sim, o, Log, CodeBase))
+      return EC;
   // Set PC
   Sim.setPC(0x0);
+  return std::error_code();
 }
 
-// Load an object
-static void LoadBinary(AAPSimulator &Sim, std::string filename) {
+// Load an object, keeping it in Result so that its symbols can be used
+// later. CodeBase is set to the bits of code addresses above the 24-bit
+// code space.
+static std::error_code LoadBinary(AAPSimulator &Sim, StringRef filename,
+                                  raw_ostream &Log,
+                                  OwningBinary<Binary> &Result,
+                                  uint64_t &CodeBase) {
   // Attempt to open the binary.
   Expected<OwningBinary<Binary>> BinaryOrErr = createBinary(filename);
   if (auto Err = BinaryOrErr.takeError())
-    report_error(filename, errorToErrorCode(std::move(Err)));
+    return errorToErrorCode(std::move(Err));
   Binary &Binary = *BinaryOrErr.get().getBinary();
-  if (ObjectFile *o = dyn_cast<ObjectFile>(&Binary))
-    LoadObject(Sim, o);
-  else
-    report_error(filename, object_error::invalid_file_type);
+  ObjectFile *o = dyn_cast<ObjectFile>(&Binary);
+  if (!o)
+    return object_error::invalid_file_type;
+
+  // Keep a descriptor open while loading, so that segments can be mapped
+  // directly from the file. If that fails, everything is copied.
+  int FD = -1;
+  if (sys::fs::openFileForRead(filename, FD))
+    FD = -1;
+  std::error_code EC = LoadObject(Sim, o, FD, Log, CodeBase);
+  if (FD >= 0)
+    sys::Process::SafelyCloseFileDescriptor(FD);
+  Result = std::move(BinaryOrErr.get());
+  return EC;
 }
 
 static cl::opt<bool>
@@ -91,49 +183,352 @@ DebugTrace("debug-trace", cl::desc("Enable debug tracing"));
 static cl::opt<bool>
 DebugTrace2("d", cl::desc("Enable debug tracing"), cl::Hidden);
 
+static cl::opt<SimEngine>
+Engine("engine", cl::desc("Execution engine"),
+       cl::values(clEnumValN(SimEngine::Interpreter, "interp",
+                             "Reference instruction interpreter"),
+                  clEnumValN(SimEngine::Block, "block",
+                             "Basic block translation (default)")),
+       cl::init(SimEngine::Block));
+
+enum class StatsFormat { None, JSON, CSV };
+
+// LLVM already registers -stats for its own statistics
+static cl::opt<StatsFormat>
+Stats("sim-stats", cl::desc("Print execution statistics on exit"),
+      cl::values(clEnumValN(StatsFormat::JSON, "json", "JSON"),
+                 clEnumValN(StatsFormat::CSV, "csv", "Comma separated")),
+      cl::init(StatsFormat::None));
+
+static cl::opt<std::string>
+StatsFile("sim-stats-file",
+          cl::desc("Write statistics to a file (default: stderr)"),
+          cl::value_desc("filename"), cl::init("-"));
+
+enum class ProfileFormat { Flat, Sample };
+
+static cl::opt<std::string>
+ProfileFile("profile", cl::desc("Write a function level profile to a file"),
+            cl::value_desc("filename"));
+
+static cl::opt<ProfileFormat>
+ProfileFmt("profile-format", cl::desc("Profile output format"),
+           cl::values(clEnumValN(ProfileFormat::Flat, "flat",
+                                 "Flat profile and call graph (default)"),
+                      clEnumValN(ProfileFormat::Sample, "sample",
+                                 "Sample profile text format, for use with "
+                                 "llvm-profdata merge --sample")),
+           cl::init(ProfileFormat::Flat));
+
 static cl::opt<double>
-Timeout("timeout", cl::desc("Timeout in seconds"), cl::value_desc("duration"), cl::init(0.0));
+Timeout("timeout", cl::desc("Wall clock timeout in seconds"),
+        cl::value_desc("duration"), cl::init(0.0));
+
+static cl::opt<unsigned long long>
+MaxInstructions("max-instructions",
+                cl::desc("Stop with a timeout after executing this many "
+                         "instructions (default: no limit)"),
+                cl::value_desc("count"), cl::init(0));
+
+static cl::opt<std::string>
+BatchManifest("batch",
+              cl::desc("Run every binary listed in a manifest. Each line "
+                       "holds a path, relative to the manifest, and an "
+                       "optional expected exit code (default: 0)"),
+              cl::value_desc("manifest"));
+
+static cl::opt<unsigned>
+Threads("j", cl::desc("Number of binaries to simulate in parallel in batch "
+                      "mode (default: number of cores)"),
+        cl::init(0));
+
+static cl::opt<std::string>
+SaveSnapshot("save-snapshot",
+             cl::desc("Save a snapshot of the simulator state when the "
+                      "program hits a breakpoint"),
+             cl::value_desc("filename"));
+
+static cl::opt<std::string>
+RestoreSnapshot("restore-snapshot",
+                cl::desc("Start from a saved snapshot instead of the "
+                         "loaded object"),
+                cl::value_desc("filename"));
+
+// Print execution statistics in the requested format
+static void PrintStats(AAPSimulator &Sim) {
+  std::unique_ptr<raw_fd_ostream> File;
+  raw_ostream *OS = &errs();
+  if (StatsFile != "-") {
+    std::error_code EC;
+    File.reset(new raw_fd_ostream(StatsFile, EC, sys::fs::F_Text));
+    if (EC)
+      report_error(StatsFile, EC);
+    OS = File.get();
+  }
+  if (Stats == StatsFormat::JSON)
+    Sim.getStats().printJSON(*OS, Sim.getInstrInfo());
+  else
+    Sim.getStats().printCSV(*OS, Sim.getInstrInfo());
+}
+
+// Write a profile of the executed binary
+static void WriteProfile(AAPSimulator &Sim, const ObjectFile &Obj,
+                         uint64_t CodeBase) {
+  std::error_code EC;
+  raw_fd_ostream OS(ProfileFile, EC, sys::fs::F_Text);
+  if (EC)
+    report_error(ProfileFile, EC);
+  AAPProfileWriter Writer(Obj, CodeBase);
+  if (ProfileFmt == ProfileFormat::Sample) {
+    if (!Writer.hasLineTable())
+      errs() << ToolName << ": warning: '" << Obj.getFileName()
+             << "': no line table, so the sample profile is empty\n";
+    Writer.writeSampleProfile(OS, Sim.getStats());
+  }
+  else
+    Writer.writeFlat(OS, Sim.getStats());
+}
+
+namespace {
+// Watchdog - asks a simulator to stop once the wall clock timeout expires.
+// The timer runs on its own thread so that the simulator never has to read
+// the clock.
+class Watchdog {
+  std::mutex Lock;
+  std::condition_variable Cond;
+  bool Done;
+  std::thread Thread;
+
+public:
+  Watchdog(AAPSimulator &Sim, double Seconds) : Done(false) {
+    Thread = std::thread([this, &Sim, Seconds] {
+      std::unique_lock<std::mutex> Guard(Lock);
+      if (!Cond.wait_for(Guard, std::chrono::duration<double>(Seconds),
+                         [this] { return Done; }))
+        Sim.requestStop();
+    });
+  }
+
+  ~Watchdog() {
+    {
+      std::lock_guard<std::mutex> Guard(Lock);
+      Done = true;
+    }
+    Cond.notify_one();
+    Thread.join();
+  }
+};
+} // end anonymous namespace
+
+// Run the loaded program until it stops, the instruction budget is used up
+// or the timeout expires
+static SimStatus RunSimulator(AAPSimulator &Sim) {
+  std::unique_ptr<Watchdog> Timer;
+  if (Timeout > 0.0)
+    Timer.reset(new Watchdog(Sim, Timeout));
+
+  uint64_t Budget = MaxInstructions ? MaxInstructions : UINT64_MAX;
+  SimStatus status = Sim.run(Budget);
+  // The program is still running after the whole budget
+  if (status == SimStatus::SIM_OK)
+    status = SimStatus::SIM_TIMEOUT;
+  return status;
+}
+
+static const char *getStatusString(SimStatus status) {
+  switch (status) {
+    case SimStatus::SIM_OK:           return "running";
+    case SimStatus::SIM_INVALID_INSN: return "invalid instruction";
+    case SimStatus::SIM_BREAKPOINT:   return "breakpoint";
+    case SimStatus::SIM_QUIT:         return "exit";
+    case SimStatus::SIM_TRAP:         return "simulator trap";
+    case SimStatus::SIM_EXCEPT_MEM:   return "invalid memory trap";
+    case SimStatus::SIM_EXCEPT_REG:   return "invalid register trap";
+    case SimStatus::SIM_TIMEOUT:      return "timeout";
+  }
+  llvm_unreachable("Invalid simulator status");
+}
+
+namespace {
+/// BatchJob - a binary run in batch mode, and its result
+struct BatchJob {
+  std::string Filename;
+  unsigned ExpectedExitCode;
+
+  std::error_code Error;    // Error loading the binary
+  SimStatus Status;
+  unsigned ExitCode;
+  double Seconds;
+  std::string Output;       // Output of the simulated program
+
+  bool passed() const {
+    return !Error && Status == SimStatus::SIM_QUIT &&
+           ExitCode == ExpectedExitCode;
+  }
+};
+} // end anonymous namespace
+
+// Run a single batch job on a simulator which has been reset
+static void RunBatchJob(AAPSimulator &Sim, BatchJob &Job) {
+  auto Start = std::chrono::steady_clock::now();
+
+  raw_string_ostream Output(Job.Output);
+  Sim.setOutput(Output, Output);
+
+  OwningBinary<Binary> Bin;
+  uint64_t CodeBase;
+  Job.Error = LoadBinary(Sim, Job.Filename, nulls(), Bin, CodeBase);
+  Job.Status = SimStatus::SIM_OK;
+  Job.ExitCode = 0;
+  if (!Job.Error) {
+    Job.Status = RunSimulator(Sim);
+    Job.ExitCode = Sim.getState().getExitCode();
+  }
+
+  Output.flush();
+  Sim.setOutput(nulls(), nulls());
+  Job.Seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - Start).count();
+}
+
+// Run every binary in the batch manifest, returning the tool's exit code
+static int RunBatch() {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> ManifestOrErr =
+      MemoryBuffer::getFileOrSTDIN(BatchManifest);
+  if (std::error_code EC = ManifestOrErr.getError())
+    report_error(BatchManifest, EC);
+
+  // Parse the manifest. Blank lines and lines starting with '#' are ignored.
+  SmallString<128> BaseDir = sys::path::parent_path(BatchManifest);
+  std::vector<BatchJob> Jobs;
+  SmallVector<StringRef, 16> Lines;
+  (*ManifestOrErr)->getBuffer().split(Lines, '\n');
+  for (StringRef Line : Lines) {
+    Line = Line.trim();
+    if (Line.empty() || Line.startswith("#"))
+      continue;
+    std::pair<StringRef, StringRef> Fields = getToken(Line);
+    StringRef Expected = Fields.second.trim();
+    BatchJob Job;
+    Job.ExpectedExitCode = 0;
+    if (!Expected.empty() && Expected.getAsInteger(0, Job.ExpectedExitCode))
+      report_error(BatchManifest, object_error::parse_failed);
+    SmallString<128> Path;
+    if (sys::path::is_relative(Fields.first) && BatchManifest != "-")
+      Path = BaseDir;
+    sys::path::append(Path, Fields.first);
+    Job.Filename = Path.str();
+    Jobs.push_back(std::move(Job));
+  }
+
+  // Each worker owns a simulator, reset between binaries
+  unsigned NumWorkers = Threads ? Threads : hardware_concurrency();
+  NumWorkers = std::max(1u, std::min<unsigned>(NumWorkers, Jobs.size()));
+  std::atomic<size_t> NextJob(0);
+  {
+    ThreadPool Pool(NumWorkers);
+    for (unsigned i = 0; i != NumWorkers; ++i)
+      Pool.async([&]() {
+        AAPSimulator Sim;
+        Sim.setEngine(Engine);
+        for (size_t J = NextJob++; J < Jobs.size(); J = NextJob++) {
+          Sim.reset();
+          RunBatchJob(Sim, Jobs[J]);
+        }
+      });
+    Pool.wait();
+  }
+
+  // Report results in manifest order
+  unsigned Passed = 0;
+  double TotalSeconds = 0.0;
+  for (const BatchJob &Job : Jobs) {
+    TotalSeconds += Job.Seconds;
+    if (Job.passed()) {
+      ++Passed;
+      outs() << "PASS: " << Job.Filename
+             << format(" (%.3fs)\n", Job.Seconds);
+      continue;
+    }
+    outs() << "FAIL: " << Job.Filename << " (";
+    if (Job.Error)
+      outs() << Job.Error.message();
+    else if (Job.Status == SimStatus::SIM_QUIT)
+      outs() << "exit code " << Job.ExitCode << ", expected "
+             << Job.ExpectedExitCode;
+    else
+      outs() << getStatusString(Job.Status);
+    outs() << format(", %.3fs)\n", Job.Seconds);
+    if (!Job.Output.empty())
+      outs() << Job.Output << "\n";
+  }
+  outs() << Passed << " of " << Jobs.size() << " binaries passed"
+         << format(" (%.3fs simulated)\n", TotalSeconds);
+
+  return Passed == Jobs.size() ? 0 : 1;
+}
 
 int main(int argc, char **argv) {
   // Init LLVM, call llvm_shutdown() on exit, parse args, etc.
   PrettyStackTraceProgram X(argc, argv);
   llvm_shutdown_obj Y;
 
-  // Initialize targets and assembly printers/parsers.
-  // (FIXME: Move this into AAPSimulator?)
-  llvm::InitializeAllTargetInfos();
-  llvm::InitializeAllTargetMCs();
-  llvm::InitializeAllDisassemblers();
+  // Initialize only the parts of the AAP target used by the simulator
+  AAPSim::initialize();
 
   cl::AddExtraVersionPrinter(TargetRegistry::printRegisteredTargetsForVersion);
   cl::ParseCommandLineOptions(argc, argv, "AAP Simulator Test\n");
 
+  ToolName = argv[0];
+
+  if (!BatchManifest.empty())
+    return RunBatch();
+  if (InputFilename.empty() && RestoreSnapshot.empty()) {
+    errs() << ToolName << ": no input object or batch manifest specified\n";
+    return 1;
+  }
+
   // Set up Simulator
   AAPSimulator Sim;
   Sim.setTracing(DebugTrace || DebugTrace2);
+  Sim.setEngine(Engine);
+  Sim.setProfiling(!ProfileFile.empty());
 
-  // Set up timeout if specified
-  std::chrono::time_point <std::chrono::system_clock, std::chrono::duration<double> > timeoutEnd =
-      std::chrono::system_clock::now() + std::chrono::duration<double>(Timeout);
-  bool timeoutActive = Timeout > 0.0;
-
-  ToolName = argv[0];
+  // Load Binary. When restoring a snapshot it is only used for its symbols.
+  OwningBinary<Binary> Bin;
+  uint64_t CodeBase = 0;
+  if (!InputFilename.empty())
+    if (std::error_code EC = LoadBinary(Sim, InputFilename, outs(), Bin,
+                                        CodeBase))
+      report_error(InputFilename, EC);
 
-  // Load Binary
-  LoadBinary(Sim, InputFilename);
-  unsigned stepCount = 0;
-  SimStatus status = SimStatus::SIM_OK;
-  while (status == SimStatus::SIM_OK) {
-    status = Sim.step();
-    if (timeoutActive && stepCount++ == 10000) {
-      stepCount = 0;
-      if (std::chrono::system_clock::now() > timeoutEnd) {
-        status = SimStatus::SIM_TIMEOUT;
-        break;
-      }
+  if (!RestoreSnapshot.empty()) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> SnapshotOrErr =
+        MemoryBuffer::getFile(RestoreSnapshot);
+    if (std::error_code EC = SnapshotOrErr.getError())
+      report_error(RestoreSnapshot, EC);
+    if (Error Err = Sim.restoreSnapshot((*SnapshotOrErr)->getBuffer())) {
+      logAllUnhandledErrors(std::move(Err), errs(),
+                            ToolName + ": '" + RestoreSnapshot + "': ");
+      return 1;
     }
   }
 
+  SimStatus status = RunSimulator(Sim);
+
+  if (status == SimStatus::SIM_BREAKPOINT && !SaveSnapshot.empty()) {
+    std::error_code EC;
+    raw_fd_ostream OS(SaveSnapshot, EC, sys::fs::F_None);
+    if (EC)
+      report_error(SaveSnapshot, EC);
+    Sim.saveSnapshot(OS);
+  }
+
+  if (Stats != StatsFormat::None)
+    PrintStats(Sim);
+  if (!ProfileFile.empty() && Bin.getBinary())
+    WriteProfile(Sim, *cast<ObjectFile>(Bin.getBinary()), CodeBase);
+
   // Deal with the final simulator status
   switch (status) {
     case SimStatus::SIM_OK:
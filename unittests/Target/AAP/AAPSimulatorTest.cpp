@@ -0,0 +1,81 @@
+//===- AAPSimulatorTest.cpp - AAP simulator unit tests --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "AAPSimulator.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace AAPSim;
+
+namespace {
+
+// movi $r2, <imm>; nop $r2, 2, which exits with the immediate
+std::string exitWith(uint8_t Code) {
+  return std::string{char(0x80 | Code), 0x1e, char(0x82), 0x00};
+}
+
+const SimEngine Engines[] = {SimEngine::Interpreter, SimEngine::Block};
+
+// Run from the start of code memory until the program exits, returning its
+// exit code
+unsigned runToExit(AAPSimulator &Sim) {
+  Sim.setPC(0);
+  EXPECT_EQ(SimStatus::SIM_QUIT, Sim.run(100));
+  return Sim.getState().getExitCode();
+}
+
+// Code which has already been decoded, and for the block engine translated,
+// must not be reused once the code memory holding it is rewritten.
+TEST(AAPSimulatorTest, RewriteExecutedCode) {
+  for (SimEngine Engine : Engines) {
+    AAPSimulator Sim;
+    Sim.setEngine(Engine);
+    ASSERT_TRUE(Sim.WriteCodeSection(exitWith(5), 0));
+    EXPECT_EQ(5u, runToExit(Sim));
+
+    // Change the immediate of the movi
+    Sim.getState().setCodeMem(0, 0x87);
+    EXPECT_EQ(7u, runToExit(Sim));
+  }
+}
+
+TEST(AAPSimulatorTest, ReloadExecutedCode) {
+  for (SimEngine Engine : Engines) {
+    AAPSimulator Sim;
+    Sim.setEngine(Engine);
+    ASSERT_TRUE(Sim.WriteCodeSection(exitWith(5), 0));
+    EXPECT_EQ(5u, runToExit(Sim));
+
+    ASSERT_TRUE(Sim.WriteCodeSection(exitWith(9), 0));
+    EXPECT_EQ(9u, runToExit(Sim));
+  }
+}
+
+TEST(AAPSimulatorTest, RestoreSnapshotOverExecutedCode) {
+  std::string Snapshot;
+  {
+    AAPSimulator Saved;
+    ASSERT_TRUE(Saved.WriteCodeSection(exitWith(7), 0));
+    raw_string_ostream OS(Snapshot);
+    Saved.saveSnapshot(OS);
+  }
+
+  for (SimEngine Engine : Engines) {
+    AAPSimulator Sim;
+    Sim.setEngine(Engine);
+    ASSERT_TRUE(Sim.WriteCodeSection(exitWith(5), 0));
+    EXPECT_EQ(5u, runToExit(Sim));
+
+    ASSERT_FALSE(errorToBool(Sim.restoreSnapshot(Snapshot)));
+    EXPECT_EQ(7u, runToExit(Sim));
+  }
+}
+
+} // end anonymous namespace